@@ -3,6 +3,7 @@ import sys
 import gdb
 import gdb.printing
 import struct
+import json
 import fcntl
 import termios
 from gdb.FrameDecorator import FrameDecorator
@@ -14,9 +15,11 @@ richiesta_type = gdb.lookup_type('richiesta')
 richiesta_ptr_type = gdb.Type.pointer(richiesta_type)
 des_sem_type = gdb.lookup_type('des_sem')
 des_sem_p = gdb.Type.pointer(des_sem_type)
+nodo_attesa_type = gdb.lookup_type('nodo_attesa')
+des_attesa_type = gdb.lookup_type('des_attesa')
 
 # which des_proc fields we should show
-des_proc_std_fields = [ None, 'id', 'cr3', 'contesto', 'livello', 'precedenza', 'puntatore', 'punt_nucleo', 'corpo', 'parametro' ]
+des_proc_std_fields = [ None, 'id', 'cr3', 'contesto', 'livello', 'precedenza', 'puntatore', 'punt_nucleo', 'corpo', 'parametro', 'precedenza_base', 'mutex_atteso', 'mutex_posseduti', 'tick_cpu', 'tick_quanto', 'stat', 'tsc_uscita', 'attesa' ]
 toshow = [ f for f in des_proc_type.fields() if f.name not in des_proc_std_fields ]
 
 # cache the vdf
@@ -25,6 +28,7 @@ vdf = gdb.parse_and_eval("vdf");
 # cache some constants
 max_liv  = int(gdb.parse_and_eval('$MAX_LIV'))
 max_sem = int(gdb.parse_and_eval('$MAX_SEM'))
+max_mutex = int(gdb.parse_and_eval('$MAX_MUTEX'))
 sc_desc  = int(gdb.parse_and_eval('$SEL_CODICE_SISTEMA'))
 uc_desc  = int(gdb.parse_and_eval('$SEL_CODICE_UTENTE'))
 ud_desc  = int(gdb.parse_and_eval('$SEL_DATI_UTENTE'))
@@ -34,6 +38,7 @@ min_prio = int(gdb.parse_and_eval('$MIN_PRIORITY'))
 dummy_prio = int(gdb.parse_and_eval('DUMMY_PRIORITY'))
 m_parts = [ 'sis_c', 'sis_p', 'mio_c', 'utn_c', 'utn_p' ]
 m_ini = [ int(gdb.parse_and_eval('$I_' + x.upper())) for x in m_parts ]
+m_num = [ int(gdb.parse_and_eval('$N_' + x.upper())) for x in m_parts ]
 m_names = []
 for i, p in enumerate(m_parts):
     tr = { 'sis': 'sistema', 'mio': 'IO', 'utn': 'utente' }
@@ -41,16 +46,249 @@ for i, p in enumerate(m_parts):
     m_names.append(tr[r] + "/" + ('condiviso' if c == 'c' else 'privato'))
 m_ini.append(256)
 
+# Local decoding of kernel structures.
+#
+# Reading a structure field by field through gdb.Value costs one round trip
+# to the gdbstub per field. Instead, we read the whole structure with a
+# single read_memory() and decode it here, using the layout gdb gives us.
+scalar_codes = [ gdb.TYPE_CODE_INT, gdb.TYPE_CODE_PTR, gdb.TYPE_CODE_ENUM,
+                 gdb.TYPE_CODE_BOOL, gdb.TYPE_CODE_CHAR ]
+
+def scalar_fmt(t):
+    """struct format for a scalar type, or None"""
+    t = t.strip_typedefs()
+    if t.code not in scalar_codes or t.sizeof not in [1, 2, 4, 8]:
+        return None
+    c = { 1: 'b', 2: 'h', 4: 'i', 8: 'q' }[t.sizeof]
+    return c if is_signed(t) else c.upper()
+
+def is_signed(t):
+    """whether t (without typedefs) is a signed integer or character type"""
+    if t.code not in [ gdb.TYPE_CODE_INT, gdb.TYPE_CODE_CHAR ]:
+        return False
+    # Type.is_signed only exists since GDB 12
+    if hasattr(t, 'is_signed'):
+        return t.is_signed
+    return gdb.Value(-1).cast(t) < 0
+
+class Layout:
+    """layout of a struct type, for decoding it from raw memory"""
+
+    def __init__(self, t):
+        t = t.strip_typedefs()
+        self.size = t.sizeof
+        self.fields = []
+        for f in t.fields():
+            if f.bitsize or not hasattr(f, 'bitpos'):
+                continue
+            ft = f.type.strip_typedefs()
+            off = f.bitpos // 8
+            if ft.code in [ gdb.TYPE_CODE_STRUCT, gdb.TYPE_CODE_UNION ]:
+                sub = Layout(ft)
+                if f.name:
+                    self.fields.append((f.name, off, sub, False))
+                else:
+                    # anonymous struct or union: its fields belong to us
+                    self.fields += [ (n, off + o, fmt, a) for n, o, fmt, a in sub.fields ]
+            elif f.name is None:
+                continue
+            elif ft.code == gdb.TYPE_CODE_ARRAY:
+                et = ft.target()
+                c = scalar_fmt(et)
+                if c is None or not et.sizeof:
+                    continue
+                self.fields.append((f.name, off, struct.Struct('<{}{}'.format(ft.sizeof // et.sizeof, c)), True))
+            else:
+                c = scalar_fmt(ft)
+                if c is not None:
+                    self.fields.append((f.name, off, struct.Struct('<' + c), False))
+
+    def decode(self, mem, base=0):
+        """decode the struct at offset base of mem into a dict
+(fields which cannot be decoded locally are missing)"""
+        d = {}
+        for name, off, fmt, array in self.fields:
+            if isinstance(fmt, Layout):
+                d[name] = fmt.decode(mem, base + off)
+            elif array:
+                d[name] = list(fmt.unpack_from(mem, base + off))
+            else:
+                d[name] = fmt.unpack_from(mem, base + off)[0]
+        return d
+
+def read_mem(addr, size):
+    """read size bytes of guest memory with a single request"""
+    return bytes(gdb.selected_inferior().read_memory(addr, size))
+
+def read_array(name, n, fmt='Q'):
+    """read the first n elements of the scalar array 'name'"""
+    a = gdb.parse_and_eval(name)
+    return struct.unpack('<{}{}'.format(n, fmt), read_mem(toi(a.address), n * struct.calcsize(fmt)))
+
+layouts = {}
+def layout(t):
+    """the Layout of type t (cached)"""
+    t = t.strip_typedefs()
+    if str(t) not in layouts:
+        layouts[str(t)] = Layout(t)
+    return layouts[str(t)]
+
+des_proc_layout = layout(des_proc_type)
+
+class Struct:
+    """a struct read with a single request.
+Fields are returned as python ints (arrays as lists, structs as dicts);
+fields that cannot be decoded locally are taken from gdb."""
+
+    def __init__(self, t, addr, fields=None):
+        self.type = t.strip_typedefs()
+        self.addr = addr
+        self.fields = fields if fields is not None else \
+            layout(self.type).decode(read_mem(addr, self.type.sizeof))
+        self._value = None
+
+    def value(self):
+        """the struct as a gdb.Value"""
+        if self._value is None:
+            self._value = gdb.Value(self.addr).cast(self.type.pointer()).dereference()
+        return self._value
+
+    def __getitem__(self, k):
+        if isinstance(k, gdb.Field):
+            k = k.name
+        if k in self.fields:
+            return self.fields[k]
+        return self.value()[k]
+
+    def __str__(self):
+        return str(self.value())
+
+class Proc(Struct):
+    """a des_proc read with a single request"""
+
+    def __init__(self, addr, fields=None):
+        super(Proc, self).__init__(des_proc_type, addr, fields)
+
+def field_str(s, f):
+    """format field f of the Struct s, without asking gdb if possible"""
+    v = s.fields.get(f.name)
+    code = f.type.strip_typedefs().code
+    if v is None or code not in [ gdb.TYPE_CODE_INT, gdb.TYPE_CODE_BOOL ]:
+        return str(s.value()[f])
+    if code == gdb.TYPE_CODE_BOOL:
+        return 'true' if v else 'false'
+    return str(v)
+
+# Snapshot of the kernel state.
+#
+# The commands below, the pretty printers and the context shown at each stop
+# look at the same kernel structures over and over. While the target is
+# stopped we read each of them at most once, and keep the result here until
+# the target is resumed or its memory or registers are changed from gdb.
+# snap_seq is advanced every time the snapshot is thrown away, so that front
+# ends can tell whether anything may have changed (see process_list_json()).
+snapshot = {}
+snap_seq = 0
+
+def snap(key, read):
+    """the value cached in the snapshot under key, computed with read()
+if missing"""
+    if key not in snapshot:
+        snapshot[key] = read()
+    return snapshot[key]
+
+def snap_invalidate(*args):
+    global snap_seq
+    snapshot.clear()
+    snap_seq += 1
+
+for ev in [ 'stop', 'cont', 'exited', 'memory_changed', 'register_changed', 'inferior_call' ]:
+    if hasattr(gdb.events, ev):
+        getattr(gdb.events, ev).connect(snap_invalidate)
+
+def snap_var(name):
+    """the value of the scalar global 'name', as an int"""
+    return snap(('var', name), lambda: toi(gdb.parse_and_eval(name)))
+
+def snap_proc(addr):
+    """the des_proc at addr, as a Proc"""
+    return snap(('struct', 'des_proc', addr), lambda: Proc(addr))
+
+def snap_struct(t, addr):
+    """the struct of type t at addr, as a Struct"""
+    t = t.strip_typedefs()
+    if str(t) == 'des_proc':
+        return snap_proc(addr)
+    return snap(('struct', str(t), addr), lambda: Struct(t, addr))
+
+def snap_value(val):
+    """the Struct for val, if val is in memory, otherwise val itself"""
+    if val.address is None:
+        return val
+    return snap_struct(val.type, toi(val.address))
+
+def snap_array(name, first=0, n=None):
+    """elements [first, first + n) of the global struct array 'name' (all
+the elements from first, if n is None), read with a single request"""
+    def read():
+        a = gdb.parse_and_eval(name)
+        t = a.type.strip_typedefs().target().strip_typedefs()
+        cnt = n if n is not None else a.type.sizeof // t.sizeof - first
+        base = toi(a.address) + first * t.sizeof
+        mem = read_mem(base, cnt * t.sizeof) if cnt else b''
+        l = layout(t)
+        elems = []
+        for k in range(cnt):
+            addr = base + k * t.sizeof
+            fields = l.decode(mem, k * t.sizeof)
+            s = Proc(addr, fields) if str(t) == 'des_proc' else Struct(t, addr, fields)
+            elems.append(snapshot.setdefault(('struct', str(t), addr), s))
+        return elems
+    return snap(('array', name, first, n), read)
+
+def proc_table():
+    """the contents of proc_table"""
+    return snap('proc_table', lambda: read_array('proc_table', max_proc))
+
+des_frame_fmt = { 4: 'I', 8: 'Q' }[gdb.lookup_type('des_frame').sizeof]
+
+def frames():
+    """the frame descriptors (vdf), as raw integers: prossimo_libero for
+the free frames, nvalide (in the low 16 bits) for the others"""
+    get_frames()
+    return snap('vdf', lambda: read_array('vdf', N_FRAME, des_frame_fmt))
+
+def frame_map():
+    """the state of the M2 frames: None if free, nvalide otherwise"""
+    def read():
+        vdf = frames()
+        occ = [ v & 0xFFFF for v in vdf[N_M1:] ]
+        f = snap_var('primo_frame_libero')
+        for _ in range(snap_var('num_frame_liberi')):
+            if f < N_M1 or f >= N_FRAME:
+                break
+            occ[f - N_M1] = None
+            f = vdf[f]
+        return occ
+    return snap('frame_map', read)
+
+def now_tick():
+    """number of timer interrupts since boot"""
+    try:
+        return snap_var('orologio')
+    except gdb.error:
+        return 0
+
 def is_curproc(p):
     """true iff p is the current process"""
-    return p['id'] == gdb.parse_and_eval('esecuzione->id')
+    return toi(p['id']) == snap_proc(snap_var('esecuzione'))['id']
 
 def get_process(pid):
     """convert from pid to des_proc *"""
-    p = gdb.parse_and_eval('proc_table[{}]'.format(pid))
-    if p == gdb.Value(0):
+    pid = int(pid)
+    if pid < 0 or pid >= max_proc or not proc_table()[pid]:
         return None
-    return p
+    return gdb.Value(proc_table()[pid]).cast(des_proc_ptr_type)
 
 N_M1 = 0
 N_FRAME = 0
@@ -60,27 +298,98 @@ def get_frames():
         N_M1 = int(gdb.parse_and_eval('N_M1'))
         N_FRAME = int(gdb.parse_and_eval('N_FRAME'))
 
+corpo_cache = {}
 def dump_corpo(proc):
-    c = proc['corpo'];
+    c = toi(proc['corpo'])
     if not c:
         return ''
-    return "{}:{}({})".format(*resolve_function(toi(c))[::-1], toi(proc['parametro']))
+    if c not in corpo_cache:
+        corpo_cache[c] = resolve_function(c)[::-1]
+    return "{}:{}({})".format(*corpo_cache[c], toi(proc['parametro']))
+
+def int_frame(proc):
+    """the frame saved by the INT on the system stack of proc:
+(vstack, stack, rip, cs, rflags, rsp, ss), where stack is the physical
+address corresponding to vstack"""
+    def read():
+        vstack = toi(proc['contesto'][4])
+        stack = v2p(toi(proc['cr3']), vstack)
+        return (vstack, stack) + struct.unpack('<5Q', read_mem(stack, 40))
+    return snap(('int_frame', proc.addr), read)
+
+# Machine-readable output.
+#
+# The commands that accept a '-json' (or '--json') option write a single
+# compact JSON document on one line, built from the snapshot, for front
+# ends such as the nucleo-debugger extension.
+ansi_re = re.compile(r'\x1b\[[0-9;]*m')
+
+def plain(s):
+    """remove the colors from s"""
+    return ansi_re.sub('', str(s))
+
+def json_arg(arg):
+    """return (True, rest of arg) if arg contains -json or --json,
+(False, arg) otherwise"""
+    args = arg.split()
+    j = [ a for a in args if a in [ '-json', '--json' ] ]
+    return bool(j), ' '.join(a for a in args if a not in j)
+
+def json_write(doc):
+    gdb.write(json.dumps(doc, separators=(',', ':')) + "\n")
+
+def proc_ref(proc):
+    """a process in a queue, as a JSON object"""
+    return { 'pid': toi(proc['id']), 'precedenza': toi(proc['precedenza']) }
+
+def process_json(pid, proc, brief=False):
+    """the des_proc of a process as a JSON object. If brief, leave out
+the dump of the system stack and of the registers."""
+    vstack, stack, rip, cs, rflags, rsp, ss = int_frame(proc)
+    rip_s = "{}".format(gdb.Value(rip).cast(void_ptr_type)).split()
+    p = {
+        'pid': pid,
+        'livello': "utente" if toi(proc['livello']) == 3 else "sistema",
+        'precedenza': toi(proc['precedenza']),
+        'corpo': dump_corpo(proc),
+        'rip': "{:>18s} {}".format(rip_s[0], " ".join(rip_s[1:])),
+        'campi_aggiuntivi': { f.name: plain(field_str(proc, f)) for f in toshow },
+    }
+    if brief:
+        return p
+    p.update({
+        'pila_dmp': {
+            'start': "{:016x} \u279e {:x}".format(vstack, stack),
+            'cs': plain(dump_selector(cs)),
+            'rflags': plain(dump_flags(rflags)),
+            'rsp': "{:#x}".format(rsp),
+            'ss': plain(dump_selector(ss)),
+        },
+        'reg_dmp': { r: hex(toi(proc['contesto'][i])) for i, r in enumerate(registers) },
+        'cr3': plain(vm_paddr_to_str(toi(proc['cr3']))),
+    })
+    return p
 
 def process_dump(proc, indent=0, verbosity=3):
-    write_key("livello", colorize('col_usermode', "utente") if proc['livello'] == gdb.Value(3) else colorize('col_sysmode', "sistema"), indent)
+    write_key("livello", colorize('col_usermode', "utente") if toi(proc['livello']) == 3 else colorize('col_sysmode', "sistema"), indent)
     write_key("corpo", dump_corpo(proc), indent)
-    vstack = toi(proc['contesto'][4])
-    stack = v2p(toi(proc['cr3']), vstack)
+    write_key("cpu", "{} tick".format(toi(proc['tick_cpu'])), indent)
+    if (verbosity > 2):
+        st = proc['stat']
+        write_key("tsc", "cpu {} pronto {} sincr {} delay {} altro {}".format(
+            *[toi(st[f]) for f in ['cpu', 'pronto', 'sincr', 'delay', 'altro']]), indent)
+        write_key("cambi", "{} volontari, {} involontari, {} migrazioni".format(
+            toi(st['cambi_volontari']), toi(st['cambi_involontari']), toi(st['migrazioni'])), indent)
+    vstack, stack, rip, cs, rflags, rsp, ss = int_frame(proc)
     if (verbosity > 2):
         gdb.write(colorize('col_proc_hdr', "-- pila sistema ({:016x} \u279e {:x}):\n".format(vstack, stack)), indent)
-    rip = readfis(stack)
     rip_s = "{}".format(gdb.Value(rip).cast(void_ptr_type)).split()
     write_key("rip", "{:>18s} {}".format(rip_s[0], " ".join(rip_s[1:])), indent)
     if (verbosity > 2):
-        write_key("cs",  dump_selector(readfis(stack + 8)), indent)
-        write_key("rflags", dump_flags(readfis(stack + 16)), indent)
-        write_key("rsp", "{:#18x}".format(readfis(stack + 24)), indent)
-        write_key("ss",  dump_selector(readfis(stack + 32)), indent)
+        write_key("cs",  dump_selector(cs), indent)
+        write_key("rflags", dump_flags(rflags), indent)
+        write_key("rsp", "{:#18x}".format(rsp), indent)
+        write_key("ss",  dump_selector(ss), indent)
         gdb.write(colorize('col_proc_hdr', "-- contesto:\n"), indent)
         for i, r in enumerate(registers):
             write_key(r, hex(toi(proc['contesto'][i])), indent)
@@ -91,18 +400,20 @@ def process_dump(proc, indent=0, verbosity=3):
     if len(toshow) > 0:
         if verbosity > 2:
             gdb.write("\x1b[33m-- campi aggiuntivi:\x1b[m\n", indent)
+        # fields added by the exercises
         for f in toshow:
-            write_key(f.name, proc[f], indent)
+            write_key(f.name, field_str(proc, f) if isinstance(proc, Struct) else proc[f], indent)
 
 def process_list(t='all'):
-    for pid in range(max_proc):
-        p = get_process(pid)
-        if p is None:
+    """yield (pid, Proc) for all existing processes, reading proc_table
+and each des_proc with a single request"""
+    for pid, addr in enumerate(proc_table()):
+        if not addr:
             continue
-        proc = p.dereference()
-        if t == "user" and proc['livello'] != gdb.Value(3):
+        proc = snap_proc(addr)
+        if t == "user" and proc['livello'] != 3:
             continue
-        if t == "system" and proc['livello'] == gdb.Value(3):
+        if t == "system" and proc['livello'] == 3:
             continue
         yield (pid, proc)
 
@@ -115,15 +426,15 @@ def parse_process(a):
             pid = int(_pid)
         except:
             pass
-        if pid != 0xFFFFFFFF:
+        if _pid.type == des_proc_ptr_type:
+            p = snap_proc(toi(_pid))
+        elif _pid.type == des_proc_type:
+            p = snap_proc(toi(_pid.address))
+        elif pid != 0xFFFFFFFF:
             p = get_process(pid)
             if p is None:
                 return None
-            p = p.dereference()
-        elif _pid.type == des_proc_ptr_type:
-            p = pid.dereference()
-        elif _pid.type == des_proc_type:
-            p = pid
+            p = snap_proc(toi(p))
         else:
             raise TypeError("expression must be a (pointer to) des_proc or a process id")
         return p
@@ -137,32 +448,88 @@ class Process(gdb.Command):
 class ProcessDump(gdb.Command):
     """show information from the des_proc of a process.
 The argument can be any expression returning a process id or a des_proc*.
-If no arguments are given, 'esecuzione->id' is assumed."""
+If no arguments are given, 'esecuzione->id' is assumed.
+With -json, write the information as a JSON object."""
     def __init__(self):
         super(ProcessDump, self).__init__("process dump", gdb.COMMAND_DATA, gdb.COMPLETE_EXPRESSION)
 
     def invoke(self, arg, from_tty):
+        j, arg = json_arg(arg)
         p = parse_process(arg)
         if not p:
             raise gdb.GdbError("no such process")
+        if j:
+            json_write(dict(command="process_dump", **process_json(toi(p['id']), p)))
+            return
         process_dump(p)
 
+# the last list sent with 'process list -json': (seq, options, {pid: object})
+sent_procs = (None, None, {})
+
+def process_list_json(t='all', since=None, brief=False):
+    """the process list as a JSON object. If since is the sequence number
+of the last list sent, return only the differences with respect to it:
+the new processes ('added'), the pids of the terminated ones ('removed')
+and, for the others, the fields that have changed ('changed')."""
+    global sent_procs
+    seq, old_opt, old = sent_procs
+    if since is None or since != seq or (t, brief) != old_opt:
+        cur = { pid: process_json(pid, proc, brief) for pid, proc in process_list(t) }
+        sent_procs = (snap_seq, (t, brief), cur)
+        return { 'command': "process_list", 'seq': snap_seq, 'process': list(cur.values()) }
+    doc = { 'command': "process_delta", 'seq': snap_seq, 'since': since,
+            'added': [], 'removed': [], 'changed': [] }
+    if seq == snap_seq:
+        # nothing can have changed
+        return doc
+    cur = { pid: process_json(pid, proc, brief) for pid, proc in process_list(t) }
+    for pid, p in cur.items():
+        if pid not in old:
+            doc['added'].append(p)
+        elif p != old[pid]:
+            ch = { k: v for k, v in p.items() if old[pid].get(k) != v }
+            ch['pid'] = pid
+            doc['changed'].append(ch)
+    doc['removed'] = [ pid for pid in old if pid not in cur ]
+    sent_procs = (snap_seq, (t, brief), cur)
+    return doc
+
 class ProcessList(gdb.Command):
     """list existing processes
 The command accepts an optional argument which may be 'system'
 (show only system processes), 'user' (show only user processes)
-or 'all' (default, show all processes)."""
+or 'all' (default, show all processes).
+With -json, write the list as a JSON object, which also contains a
+sequence number ('seq'). With '-json -since SEQ', where SEQ is the
+sequence number of the last list received, write only what has changed.
+With -brief, leave out the dump of the system stack and of the registers
+(they can be obtained with 'process dump -json')."""
 
     def __init__(self):
         super(ProcessList, self).__init__("process list", gdb.COMMAND_DATA)
 
     def invoke(self, arg, from_tty):
+        j, arg = json_arg(arg)
+        args = arg.split()
+        since = None
+        if '-since' in args:
+            k = args.index('-since')
+            try:
+                since = int(args[k + 1])
+            except (IndexError, ValueError):
+                raise gdb.GdbError("usage: process list -json -since SEQ [all|user|system]")
+            del args[k:k + 2]
+        brief = '-brief' in args
+        arg = ' '.join(a for a in args if a != '-brief')
+        if j:
+            json_write(process_list_json(arg or 'all', since, brief))
+            return
         for pid, proc in process_list(arg):
             gdb.write("==> Processo {}\n".format(pid))
             process_dump(proc, indent=4, verbosity=0)
 
     def complete(self, text, word):
-        return [ w for w in [ 'all', 'user', 'system'] if w.startswith(word) ]
+        return [ w for w in [ 'all', 'user', 'system', '-json', '-since', '-brief' ] if w.startswith(word) ]
 
 Process()
 ProcessDump()
@@ -182,37 +549,58 @@ class DesProc(gdb.Function):
 
 DesProc()
 
+def list_elems(head, link, t=None):
+    """the elements of a list, from the snapshot (see show_list())"""
+    if isinstance(head, gdb.Value):
+        t = head.type.strip_typedefs().target()
+        head = toi(head)
+    elems, seen, p = [], set(), head
+    while p and p not in seen:
+        seen.add(p)
+        elems.append(snap_struct(t, p))
+        p = toi(elems[-1][link])
+    return elems
+
+def sem_json(i, s):
+    """a semaphore as a JSON object"""
+    attese = [ snap_proc(snap_struct(des_attesa_type, n['attesa'])['pp'])
+               for n in list_elems(s['attese'], 'succ', nodo_attesa_type) ]
+    return { 'id': i, 'counter': s['counter'],
+             'pointer': [ proc_ref(p) for p in list_elems(s['pointer'], 'puntatore', des_proc_type) ],
+             'attese': [ proc_ref(p) for p in attese ] }
+
 def sem_list(cond='all'):
-    sem = gdb.parse_and_eval("sem_allocati_utente")
-    for i in range(sem):
-        s = gdb.parse_and_eval("array_dess[{}]".format(i))
-        if cond == 'waiting' and s['pointer'] == gdb.Value(0):
-            continue
-        yield (i, s)
-    sem = gdb.parse_and_eval("sem_allocati_sistema")
-    for i in range(sem):
-        s = gdb.parse_and_eval("array_dess[{}]".format(i + max_sem))
-        if cond == 'waiting' and s['pointer'] == gdb.Value(0):
-            continue
-        yield (i + max_sem, s)
+    """yield (id, des_sem) for all the allocated semaphores"""
+    for base, allocati in [(0, 'sem_allocati_utente'), (max_sem, 'sem_allocati_sistema')]:
+        for i, s in enumerate(snap_array('array_dess', base, snap_var(allocati)), base):
+            if not s['allocato']:
+                continue
+            if cond == 'waiting' and not s['pointer'] and not s['attese']:
+                continue
+            yield (i + s['generazione'] * 2 * max_sem, s)
 
 class Semaphore(gdb.Command):
     """show the status of semaphores.
 By default, show the status of all allocated semaphores.
-With 'waiting' as argument, show only the semaphores with a non-empty waiting queue."""
+With 'waiting' as argument, show only the semaphores with a non-empty waiting queue.
+With -json, write the status as a JSON object."""
 
     def __init__(self):
         super(Semaphore, self).__init__("semaphore", gdb.COMMAND_DATA, prefix=True)
 
     def invoke(self, arg, from_tty):
+        j, arg = json_arg(arg)
+        if j:
+            json_write({ 'command': "semaphore", 'sem': [ sem_json(i, s) for i, s in sem_list(arg) ] })
+            return
         for i, s in sem_list(arg):
             gdb.write(colorize('col_var', "sem[") +
                       colorize('col_index', format(i, '5d')) +
                       colorize('col_var', "]: ") +
-                      str(s) + "\n")
+                      sem_str(s) + "\n")
 
     def complete(self, text, word):
-        return 'waiting' if 'waiting'.startswith(word) else None
+        return [ w for w in [ 'waiting', '-json' ] if w.startswith(word) ]
 
 Semaphore()
 
@@ -243,24 +631,61 @@ class NucleoFrameFilter:
 
 NucleoFrameFilter()
 
+def cpu_state():
+    """a list of (index, des_cpu, esecuzione, pronti) for the active processors.
+The processor holding the big kernel lock works on the globals esecuzione and
+pronti, the others on the copies in their des_cpu (see bkl_acquisisci in
+sistema.s)"""
+    n = snap_var('num_cpu')
+    owner = snap_var('(unsigned int)bkl')
+    res = []
+    for i, c in enumerate(snap_array('cpu', 0, n)):
+        e, p = toi(c['esecuzione']), toi(c['pronti'])
+        if n == 1 or owner == toi(c['id_apic']) + 1:
+            e, p = snap_var('esecuzione'), snap_var('pronti')
+        res.append((i, c, e, p))
+    return res
+
+def cpu_label(name, i, n):
+    """name, followed by the processor index if there is more than one"""
+    return colorize('col_var', "{:12s}".format(name + ("[{}]:".format(i) if n > 1 else ":")))
+
 code_proc = []
 class Coda_esecuzione:
+    name = 'esecuzione'
+
     def __init__(self):
         code_proc.append(self)
 
+    def to_json(self):
+        e = snap_var('esecuzione')
+        return proc_ref(snap_proc(e)) if e else None
+
     def show_waiting(self):
-        gdb.write(colorize('col_var', "esecuzione: ") + show_list(gdb.parse_and_eval("esecuzione"), 'puntatore', nmax=1, vis=proc_elem) + "\n")
+        cpus = cpu_state()
+        for i, c, e, p in cpus:
+            gdb.write(cpu_label("esecuzione", i, len(cpus)) + show_list(e, 'puntatore', nmax=1, vis=proc_elem, t=des_proc_type) + "\n")
 Coda_esecuzione()
 
 class Coda_pronti:
+    name = 'pronti'
+
     def __init__(self):
         code_proc.append(self)
 
+    def to_json(self):
+        # all the per-processor queues, one after the other
+        return [ proc_ref(q) for i, c, e, p in cpu_state() for q in list_elems(p, 'puntatore', des_proc_type) ]
+
     def show_waiting(self):
-        gdb.write(colorize('col_var', "pronti:     ") + show_list(gdb.parse_and_eval("pronti"), 'puntatore', vis=proc_elem) + "\n")
+        cpus = cpu_state()
+        for i, c, e, p in cpus:
+            gdb.write(cpu_label("pronti", i, len(cpus)) + show_list(p, 'puntatore', vis=proc_elem, t=des_proc_type) + "\n")
 Coda_pronti()
 
 class Code_semafori:
+    name = 'semafori'
+
     def __init__(self):
         code_proc.append(self)
 
@@ -268,25 +693,134 @@ class Code_semafori:
         gdb.execute("semaphore waiting")
 Code_semafori()
 
+class Code_mailbox:
+    name = 'mailbox'
+
+    def __init__(self):
+        code_proc.append(self)
+
+    def show_waiting(self):
+        for i, b in enumerate(snap_array('array_mbox', 0, snap_var('mbox_allocate'))):
+            for q in [ 'mittenti', 'riceventi' ]:
+                if b[q]:
+                    gdb.write(colorize('col_var', "mbox[") +
+                              colorize('col_index', format(i, '3d')) +
+                              colorize('col_var', "].{}: ".format(q)) +
+                              show_list(b[q], 'puntatore', vis=proc_elem, t=des_proc_type) + "\n")
+Code_mailbox()
+
+class Code_mutex:
+    name = 'mutex'
+
+    def __init__(self):
+        code_proc.append(self)
+
+    def show_waiting(self):
+        for base, allocati in [(0, 'mutex_allocati_utente'), (max_mutex, 'mutex_allocati_sistema')]:
+            for i, m in enumerate(snap_array('array_desm', base, snap_var(allocati)), base):
+                if not m['pointer']:
+                    continue
+                gdb.write(colorize('col_var', "mutex[") +
+                          colorize('col_index', format(i, '4d')) +
+                          colorize('col_var', "]: ") +
+                          show_list(m['proprietario'], 'puntatore', nmax=1, vis=proc_elem, t=des_proc_type) + " \u2190 " +
+                          show_list(m['pointer'], 'puntatore', vis=proc_elem, t=des_proc_type) + "\n")
+Code_mutex()
+
 class Coda_sospesi:
+    name = 'sospesi'
+
     def __init__(self):
         code_proc.append(self)
 
+    def to_json(self):
+        # the d_attesa are relative to the previous request: add them up
+        # to obtain the tick at which each process will be woken up
+        res, t = [], now_tick()
+        for r in list_elems(snap_var('sospesi'), 'p_rich', richiesta_type):
+            t += r['d_attesa']
+            res.append(dict(d_attesa=r['d_attesa'], sveglia=t, **proc_ref(snap_proc(r['pp']))))
+        return res
+
     def show_waiting(self):
-        gdb.write(colorize('col_var', "sospesi:  ") + show_list(gdb.parse_and_eval("sospesi"), 'p_rich') + "\n")
+        gdb.write(colorize('col_var', "sospesi:  ") + show_list(snap_var('sospesi'), 'p_rich', vis=richiesta_str, t=richiesta_type) + "\n")
 Coda_sospesi()
 
+class Queue(gdb.Command):
+    """show the process queues.
+With no arguments, show all the queues; otherwise show only the named ones
+(esecuzione, pronti, semafori, mailbox, mutex, sospesi).
+With -json, write the esecuzione, pronti and sospesi queues as a JSON object."""
+
+    def __init__(self):
+        super(Queue, self).__init__("queue", gdb.COMMAND_DATA)
+
+    def invoke(self, arg, from_tty):
+        j, arg = json_arg(arg)
+        names = arg.split()
+        for n in names:
+            if n not in [ c.name for c in code_proc ]:
+                raise gdb.GdbError("no such queue: " + n)
+        code = [ c for c in code_proc if not names or c.name in names ]
+        if j:
+            doc = { 'command': "queue", 'tick': now_tick() }
+            for c in code:
+                if hasattr(c, 'to_json'):
+                    doc[c.name] = c.to_json()
+            json_write(doc)
+            return
+        for c in code:
+            c.show_waiting()
+
+    def complete(self, text, word):
+        return [ w for w in [ c.name for c in code_proc ] + [ '-json' ] if w.startswith(word) ]
+
+Queue()
+
+class Cpu(gdb.Command):
+    """show the state of the processors.
+For each active processor show the id of its local APIC, the running process,
+the ready queue and how many processes it took from the queues of the others.
+With -json, write the same information as a JSON object."""
+
+    def __init__(self):
+        super(Cpu, self).__init__("cpu", gdb.COMMAND_DATA)
+
+    def invoke(self, arg, from_tty):
+        j, arg = json_arg(arg)
+        cpus = cpu_state()
+        if j:
+            json_write({ 'command': "cpu", 'cpu': [ {
+                'cpu': i,
+                'apic': toi(c['id_apic']),
+                'esecuzione': proc_ref(snap_proc(e)) if e else None,
+                'inattivo': bool(e) and e == toi(c['inattivo']),
+                'pronti': [ proc_ref(q) for q in list_elems(p, 'puntatore', des_proc_type) ],
+                'rubati': toi(c['rubati']),
+            } for i, c, e, p in cpus ] })
+            return
+        for i, c, e, p in cpus:
+            gdb.write(colorize('col_var', "cpu {} ".format(i)) +
+                      "(APIC {}, rubati {})\n".format(toi(c['id_apic']), toi(c['rubati'])))
+            write_key("esecuzione", show_list(e, 'puntatore', nmax=1, vis=proc_elem, t=des_proc_type), 4)
+            write_key("pronti", show_list(p, 'puntatore', vis=proc_elem, t=des_proc_type), 4)
+
+    def complete(self, text, word):
+        return [ w for w in [ '-json' ] if w.startswith(word) ]
+
+Cpu()
+
 def context_code():
     print_hdr("code processi")
-    gdb.write(colorize('col_var', 'processi:   {:d}\n'.format(int(gdb.parse_and_eval('processi')))))
+    gdb.write(colorize('col_var', 'processi:   {:d}\n'.format(snap_var('processi'))))
     for c in code_proc:
         c.show_waiting()
 
 def context_esecuzione():
-    esecuzione = gdb.parse_and_eval('esecuzione')
+    esecuzione = snap_var('esecuzione')
     if esecuzione:
         print_hdr("esecuzione")
-        gdb.write('{}\n'.format(esecuzione))
+        gdb.write('{}\n'.format(gdb.Value(esecuzione).cast(des_proc_ptr_type)))
 
 def print_context():
     get_frames()
@@ -298,20 +832,25 @@ def print_context():
     context_protezione()
     print_footer()
 
-def show_list(head, link, nmax=20, trunk='...', vis=None):
+def show_list(head, link, nmax=20, trunk='...', vis=None, t=None):
+    """head is either a pointer (gdb.Value) or an address, in which case
+t must be the type of the elements. The elements come from the snapshot."""
+    if isinstance(head, gdb.Value):
+        t = head.type.strip_typedefs().target()
+        head = toi(head)
     elems, p = [], head
     count = 0
     seen = set()
     if vis == None:
         vis = str
-    while p != gdb.Value(0):
+    while p:
         if count >= nmax:
             elems.append(trunk)
             break
-        elem = p.dereference()
-        p = elem[link]
+        elem = snap_struct(t, p)
+        p = toi(elem[link])
         elems.append(vis(elem))
-        pp = toi(p)
+        pp = p
         if pp in seen:
             elems.append('LOOP!')
             break
@@ -337,6 +876,9 @@ def proc_elem(proc):
         id_str = str(i)
     return colorize('col_proc_elem', "[{}, {}]".format(id_str, prio_str))
 
+def richiesta_str(r):
+    return "{{{}, {}}}".format(toi(r['d_attesa']), show_list(r['pp'], 'puntatore', nmax=1, vis=proc_elem, t=des_proc_type))
+
 class richiestaPrinter:
     """Print a richiesta list"""
 
@@ -344,7 +886,7 @@ class richiestaPrinter:
         self.val = val
 
     def to_string(self):
-        return "{{{}, {}}}".format(toi(self.val['d_attesa']), show_list(self.val['pp'], 'puntatore', nmax=1, vis=proc_elem))
+        return richiesta_str(snap_value(self.val))
 
 def richiestaLookup(val):
     if val.type == richiesta_type:
@@ -355,6 +897,16 @@ def richiestaLookup(val):
 
 gdb.pretty_printers.append(richiestaLookup)
 
+def attesa_elem(n):
+    """Convert a nodo_attesa to a string suitable for show_list"""
+    return proc_elem(snap_proc(snap_struct(des_attesa_type, n['attesa'])['pp']))
+
+def sem_str(s):
+    res = "{{ {}, {}".format(s['counter'], show_list(s['pointer'], 'puntatore', vis=proc_elem, t=des_proc_type))
+    if toi(s['attese']):
+        res += ", any: " + show_list(s['attese'], 'succ', vis=attesa_elem, t=nodo_attesa_type)
+    return res + " }"
+
 class des_semPrinter:
     """Print a des_sem"""
 
@@ -362,7 +914,7 @@ class des_semPrinter:
         self.val = val
 
     def to_string(self):
-        return "{{ {}, {} }}".format(self.val['counter'], show_list(self.val['pointer'], 'puntatore', vis=proc_elem))
+        return sem_str(snap_value(self.val))
 
 def des_semLookup(val):
     if val.type == des_sem_type:
@@ -411,14 +963,14 @@ class des_procPrinter:
         if self.val == gdb.Value(0):
             return 'null'
         try:
-            proc = self.val.dereference()
+            proc = snap_proc(toi(self.val))
         except:
             return '{:x} invalid'.format(toi(self.val))
         if self.__class__.recurse_level > 2:
             return '{:x} ...'.format(toi(self.val))
         s = 'id: {}, corpo: "{}", prec: {}, rax: {}'.format(proc['id'], dump_corpo(proc), proc['precedenza'], proc['contesto'][0])
         for f in toshow:
-            s += ', {}: {}'.format(f.name, proc[f])
+            s += ', {}: {}'.format(f.name, field_str(proc, f))
         return '{:x} \u279e {{ {} }}'.format(toi(self.val), s)
 
 def des_procLookup(val):
@@ -428,19 +980,560 @@ def des_procLookup(val):
 
 gdb.pretty_printers.append(des_procLookup)
 
+# tipi di evento della traccia (enum tipo_evento in sistema.cpp)
+trace_events = [ 'ENTRATA', 'USCITA', 'CAMBIO', 'BLOCCO', 'RISVEGLIO', 'ALLOCA_FRAME', 'RILASCIA_FRAME' ]
+# formato di un evento (struct evento): tsc, tipo, cpu, a, b
+trace_fmt = struct.Struct('<QHHIQ')
+# formato dell'intestazione dei file scritti da 'traccia dump': magic, versione, numero di eventi
+trace_hdr = struct.Struct('<4sII')
+
+def trace_read():
+    """return the events in the trace buffer, from the oldest"""
+    pos = int(gdb.parse_and_eval('traccia_pos'))
+    buf = gdb.parse_and_eval('traccia_buf')
+    dim = int(buf.type.sizeof // trace_fmt.size)
+    mem = gdb.selected_inferior().read_memory(toi(buf.address), dim * trace_fmt.size)
+    return [ trace_fmt.unpack_from(mem, (k % dim) * trace_fmt.size) for k in range(max(0, pos - dim), pos) ]
+
+sym_cache = {}
+def sym_name(addr):
+    """convert an address to 'symbol+offset' (cached)"""
+    if addr not in sym_cache:
+        try:
+            s = gdb.execute("info symbol {:#x}".format(addr), to_string=True).split(' in section')[0]
+            sym_cache[addr] = s.replace(' + ', '+').strip()
+        except gdb.error:
+            sym_cache[addr] = "{:#x}".format(addr)
+    return sym_cache[addr]
+
+def trace_str(ev):
+    """convert an event to a string"""
+    tsc, tipo, cpu, a, b = ev
+    name = trace_events[tipo] if tipo < len(trace_events) else str(tipo)
+    if tipo == 0:
+        arg = "proc {} {}".format(a, sym_name(b))
+    elif tipo == 1:
+        arg = "proc {}".format(a)
+    elif tipo == 2:
+        arg = "proc {} \u279e {}".format(a if a != 0xFFFFFFFF else '-', b)
+    elif tipo in [3, 4]:
+        arg = "proc {} sem[{}]".format(a, b)
+    else:
+        arg = "{:#x}".format(b)
+    return "cpu{:<2d} ".format(cpu) + colorize('col_var', "{:<15s}".format(name)) + " " + arg
+
+class Trace(gdb.Command):
+    """show the kernel event trace.
+With a number N as argument, show the last N events (default 30).
+'traccia on' and 'traccia off' enable and disable the recording of new events.
+'traccia dump FILE' writes all the events in FILE, for util/trace2json.pl.
+(Not called 'trace', which is a built-in GDB command.)"""
+
+    def __init__(self):
+        super(Trace, self).__init__("traccia", gdb.COMMAND_DATA)
+
+    def invoke(self, arg, from_tty):
+        args = arg.split()
+        if args and args[0] in [ 'on', 'off' ]:
+            gdb.execute("set var traccia_attiva = {}".format(1 if args[0] == 'on' else 0))
+            return
+        events = trace_read()
+        if args and args[0] == 'dump':
+            if len(args) < 2:
+                raise gdb.GdbError("usage: traccia dump FILE")
+            with open(args[1], 'wb') as f:
+                f.write(trace_hdr.pack(b'NTRC', 2, len(events)))
+                for ev in events:
+                    f.write(trace_fmt.pack(*ev))
+            gdb.write("{} eventi scritti in {}\n".format(len(events), args[1]))
+            return
+        n = int(args[0]) if args else 30
+        events = events[-n:]
+        if not events:
+            return
+        t0 = events[0][0]
+        for ev in events:
+            gdb.write(colorize('col_index', "{:>12d} ".format(ev[0] - t0)) + trace_str(ev) + "\n")
+
+    def complete(self, text, word):
+        return [ w for w in [ 'on', 'off', 'dump' ] if w.startswith(word) ]
+
+Trace()
+
+def profile_read():
+    """return the non empty entries of the profile table, as tuples
+(conta, id, liv, prof, pc...)"""
+    tab = gdb.parse_and_eval('profilo')
+    t = gdb.lookup_type('campione')
+    depth = int(t['pc'].type.sizeof // 8)
+    fmt = struct.Struct('<QIBB2x{}Q'.format(depth))
+    if fmt.size != t.sizeof:
+        raise gdb.GdbError("formato di 'campione' non riconosciuto")
+    dim = int(tab.type.sizeof // t.sizeof)
+    mem = gdb.selected_inferior().read_memory(toi(tab.address), dim * t.sizeof)
+    entries = [ fmt.unpack_from(mem, k * t.sizeof) for k in range(dim) ]
+    return depth, fmt, [ e for e in entries if e[0] ]
+
+# formato dell'intestazione dei file scritti da 'profile dump': magic,
+# versione, profondità, numero di campioni, campioni persi
+profile_hdr = struct.Struct('<4sIIIQ')
+
+class Profile(gdb.Command):
+    """show the sampling profile of the processes.
+With a number N as argument, show the N functions with most samples (default 20).
+'profile on' and 'profile off' enable and disable sampling on the timer interrupt.
+'profile reset' clears the samples collected so far.
+'profile dump FILE' writes all the samples in FILE, for util/profile.pl."""
+
+    def __init__(self):
+        super(Profile, self).__init__("profile", gdb.COMMAND_DATA)
+
+    def invoke(self, arg, from_tty):
+        args = arg.split()
+        if args and args[0] in [ 'on', 'off' ]:
+            gdb.execute("set var profilo_attivo = {}".format(1 if args[0] == 'on' else 0))
+            return
+        if args and args[0] == 'reset':
+            tab = gdb.parse_and_eval('profilo')
+            gdb.selected_inferior().write_memory(toi(tab.address), bytes(tab.type.sizeof))
+            snap_invalidate()
+            gdb.execute("set var profilo_persi = 0")
+            return
+        depth, fmt, entries = profile_read()
+        persi = int(gdb.parse_and_eval('profilo_persi'))
+        if args and args[0] == 'dump':
+            if len(args) < 2:
+                raise gdb.GdbError("usage: profile dump FILE")
+            with open(args[1], 'wb') as f:
+                f.write(profile_hdr.pack(b'NPRF', 1, depth, len(entries), persi))
+                for e in entries:
+                    f.write(fmt.pack(*e))
+            gdb.write("{} campioni scritti in {}\n".format(len(entries), args[1]))
+            return
+        n = int(args[0]) if args else 20
+        tot = sum(e[0] for e in entries)
+        if not tot:
+            return
+        funcs = {}
+        for e in entries:
+            f = sym_name(e[4]).split('+')[0]
+            funcs[f] = funcs.get(f, 0) + e[0]
+        gdb.write("{} campioni ({} persi)\n".format(tot, persi))
+        for f, c in sorted(funcs.items(), key=lambda x: -x[1])[:n]:
+            gdb.write(colorize('col_index', "{:6.2f}% {:8d} ".format(100.0 * c / tot, c)) + f + "\n")
+
+    def complete(self, text, word):
+        return [ w for w in [ 'on', 'off', 'reset', 'dump' ] if w.startswith(word) ]
+
+Profile()
+
+# Scheduler timeline.
+#
+# While recording, the state of the scheduler (process in execution, ready
+# queue, semaphore queues, timer queue) is saved at each stop, or at each
+# carica_stato, as a delta from the previous one. The recorded history can
+# then be browsed, here or in the Info Nucleo panel, without running the
+# guest again.
+MAX_TIMELINE = 10000
+
+def sched_state():
+    """the current state of the scheduler, as a JSON object. esecuzione and
+pronti have one element for each active processor (see cpu_state())"""
+    cpus = cpu_state()
+    sem = {}
+    for i, s in sem_list('waiting'):
+        q = [ toi(p['id']) for p in list_elems(s['pointer'], 'puntatore', des_proc_type) ]
+        q += [ toi(snap_proc(snap_struct(des_attesa_type, n['attesa'])['pp'])['id'])
+               for n in list_elems(s['attese'], 'succ', nodo_attesa_type) ]
+        sem[str(i)] = q
+    return {
+        'esecuzione': [ toi(snap_proc(e)['id']) if e else None for i, c, e, p in cpus ],
+        'pronti': [ [ toi(q['id']) for q in list_elems(p, 'puntatore', des_proc_type) ] for i, c, e, p in cpus ],
+        'sem': sem,
+        'sospesi': [ [ toi(snap_proc(r['pp'])['id']), r['d_attesa'] ]
+                     for r in list_elems(snap_var('sospesi'), 'p_rich', richiesta_type) ],
+    }
+
+sched_empty = { 'esecuzione': [], 'pronti': [], 'sem': {}, 'sospesi': [] }
+
+def sched_delta(old, new):
+    """the fields of new that differ from old. For 'sem', only the changed
+semaphores are included (None for those that have no waiting process anymore)"""
+    d = { k: v for k, v in new.items() if k != 'sem' and old[k] != v }
+    sem = { i: q for i, q in new['sem'].items() if old['sem'].get(i) != q }
+    sem.update({ i: None for i in old['sem'] if i not in new['sem'] })
+    if sem:
+        d['sem'] = sem
+    return d
+
+def sched_apply(state, d):
+    """the state obtained applying the delta d to state"""
+    s = dict(state, sem=dict(state['sem']))
+    for k, v in d.items():
+        if k != 'sem':
+            s[k] = v
+            continue
+        for i, q in v.items():
+            if q is None:
+                s['sem'].pop(i, None)
+            else:
+                s['sem'][i] = q
+    return s
+
+class Timeline:
+    """the recorded history: base is the state before the first entry
+still in memory, whose index is first. The indices keep growing across
+resets, so that a client can tell that its copy is stale"""
+
+    def __init__(self):
+        self.mode = None
+        self.bp = None
+        self.first = 0
+        self.entries = []
+        self.reset()
+
+    def reset(self):
+        self.base = sched_empty
+        self.last = sched_empty
+        self.first = self.next()
+        self.entries = []
+
+    def next(self):
+        return self.first + len(self.entries)
+
+    def record(self, motivo, dove=''):
+        try:
+            cur = sched_state()
+        except gdb.error:
+            return
+        d = sched_delta(self.last, cur)
+        if not d:
+            return
+        self.entries.append({ 'i': self.next(), 'tick': now_tick(), 'motivo': motivo, 'dove': dove, 'delta': d })
+        self.last = cur
+        if len(self.entries) > MAX_TIMELINE:
+            self.base = sched_apply(self.base, self.entries.pop(0)['delta'])
+            self.first += 1
+
+    def state(self, i):
+        """the state after entry i"""
+        s = self.base
+        for e in self.entries[:i - self.first + 1]:
+            s = sched_apply(s, e['delta'])
+        return s
+
+    def to_json(self, since=None):
+        """the entries from since on; if since is not given, is not after
+the base state or does not belong to this history, all the entries and the
+base state"""
+        doc = { 'command': "timeline", 'registrazione': self.mode, 'next': self.next() }
+        if since is None or since <= self.first or since > self.next():
+            doc.update(base=self.base, first=self.first, entries=self.entries)
+        else:
+            doc.update(first=self.first, entries=self.entries[since - self.first:])
+        return doc
+
+timeline = Timeline()
+
+class TimelineBreakpoint(gdb.Breakpoint):
+    """records the state at each carica_stato, without stopping"""
+
+    def __init__(self):
+        super(TimelineBreakpoint, self).__init__('carica_stato', internal=True)
+        self.silent = True
+
+    def stop(self):
+        snap_invalidate()
+        timeline.record('carica_stato')
+        return False
+
+def timeline_stop(event):
+    if timeline.mode != 'stop':
+        return
+    try:
+        dove = sym_name(int(gdb.selected_frame().pc())).split('+')[0]
+    except gdb.error:
+        dove = ''
+    timeline.record('stop', dove)
+
+gdb.events.stop.connect(timeline_stop)
+
+def sched_str(s):
+    """a state of the scheduler, as a string"""
+    n = len(s['esecuzione'])
+    res = ''
+    for i, e in enumerate(s['esecuzione']):
+        res += cpu_label("esecuzione", i, n) + str(e) + "\n"
+    for i, q in enumerate(s['pronti']):
+        res += cpu_label("pronti", i, n) + ' \u279e '.join(str(p) for p in q) + "\n"
+    for i, q in sorted(s['sem'].items(), key=lambda x: int(x[0])):
+        res += colorize('col_var', "sem[") + colorize('col_index', format(int(i), '5d')) + \
+               colorize('col_var', "]: ") + ' \u279e '.join(str(p) for p in q) + "\n"
+    res += colorize('col_var', "sospesi:    ") + ' \u279e '.join("{}+{}".format(p, d) for p, d in s['sospesi']) + "\n"
+    return res
+
+class TimelineCmd(gdb.Command):
+    """record and show the history of the scheduler state.
+'timeline on' records the state at each stop; 'timeline on switch' records
+it at each carica_stato, i.e., each time a process is resumed, without
+stopping the guest. 'timeline off' stops the recording and 'timeline reset'
+forgets the history.
+With a number N as argument, show the last N changes (default 20);
+'timeline show I' shows the whole state after change I.
+With -json, write the history as a JSON object, with the state before the
+first change ('base') and the changes as deltas; with '-json -since I',
+write only the changes from I on."""
+
+    def __init__(self):
+        super(TimelineCmd, self).__init__("timeline", gdb.COMMAND_DATA)
+
+    def invoke(self, arg, from_tty):
+        j, arg = json_arg(arg)
+        args = arg.split()
+        if j:
+            since = int(args[args.index('-since') + 1]) if '-since' in args else None
+            json_write(timeline.to_json(since))
+            return
+        if args and args[0] == 'on':
+            mode = 'switch' if args[1:] == [ 'switch' ] else 'stop'
+            if mode == 'switch' and timeline.bp is None:
+                timeline.bp = TimelineBreakpoint()
+            elif mode == 'stop' and timeline.bp is not None:
+                timeline.bp.delete()
+                timeline.bp = None
+            timeline.mode = mode
+            timeline.record('inizio')
+            return
+        if args and args[0] == 'off':
+            if timeline.bp is not None:
+                timeline.bp.delete()
+                timeline.bp = None
+            timeline.mode = None
+            return
+        if args and args[0] == 'reset':
+            timeline.reset()
+            return
+        if args and args[0] == 'show':
+            if len(args) < 2:
+                raise gdb.GdbError("usage: timeline show I")
+            i = int(args[1])
+            if i < timeline.first or i >= timeline.next():
+                raise gdb.GdbError("no such change")
+            gdb.write(sched_str(timeline.state(i)))
+            return
+        n = int(args[0]) if args else 20
+        for e in timeline.entries[-n:]:
+            d = e['delta']
+            parts = [ "{}={}".format(k, d[k]) for k in [ 'esecuzione', 'pronti', 'sospesi' ] if k in d ]
+            parts += [ "sem[{}]={}".format(i, q if q is not None else '[]') for i, q in d.get('sem', {}).items() ]
+            gdb.write(colorize('col_index', "{:6d} {:>10d} ".format(e['i'], e['tick'])) +
+                      "{:<12s} {} {}\n".format(e['motivo'], e['dove'], ' '.join(parts)))
+
+    def complete(self, text, word):
+        return [ w for w in [ 'on', 'off', 'reset', 'show', 'switch', '-json', '-since' ] if w.startswith(word) ]
+
+TimelineCmd()
+
+class Frames(gdb.Command):
+    """show the state of the frames of M2.
+Each frame is shown as '.' if free, '#' if it contains a page or a
+table with no valid entries, or a digit from 1 to 9 proportional to the
+number of valid entries of the table it contains.
+With -json, write the state as a JSON object, with -1 for the free
+frames and the number of valid entries for the others."""
+
+    def __init__(self):
+        super(Frames, self).__init__("frames", gdb.COMMAND_DATA)
+
+    def invoke(self, arg, from_tty):
+        j, arg = json_arg(arg)
+        occ = frame_map()
+        liberi = sum(1 for o in occ if o is None)
+        if j:
+            json_write({ 'command': "frames", 'n_m1': N_M1, 'n_frame': N_FRAME, 'liberi': liberi,
+                         'frame': [ -1 if o is None else o for o in occ ] })
+            return
+        gdb.write("M2: {} frame ({} liberi)\n".format(len(occ), liberi))
+        row = 64
+        for i in range(0, len(occ), row):
+            line = ''.join('.' if o is None else '#' if not o else str(min(9, 1 + o * 9 // 512))
+                           for o in occ[i:i + row])
+            gdb.write(colorize('col_index', "{:6d} ".format(N_M1 + i)) + line + "\n")
+
+    def complete(self, text, word):
+        return [ '-json' ] if '-json'.startswith(word) else []
+
+Frames()
+
+# Page-table walker.
+#
+# Each table is read with a single request and kept in the snapshot, so
+# the tables shared by all processes (e.g. those of sistema/condiviso) are
+# read only once per stop, and the regions of each address space are
+# computed only once per stop.
+PTE_P  = 1 << 0
+PTE_RW = 1 << 1
+PTE_US = 1 << 2
+PTE_PS = 1 << 7
+pte_addr_mask = 0x000FFFFFFFFFF000
+
+def read_tab(f):
+    """the 512 entries of the table in frame f"""
+    return snap(('tab', f), lambda: struct.unpack('<512Q', read_mem(f, 4096)))
+
+def norm(v):
+    """the canonical form of the 48 bit virtual address v"""
+    return v | 0xFFFF000000000000 if v & (1 << 47) else v
+
+def m_part(v):
+    """the index in m_parts of the part containing the virtual address v,
+or None"""
+    i = (v >> 39) & 0x1FF
+    for k, (ini, num) in enumerate(zip(m_ini, m_num)):
+        if ini <= i < ini + num:
+            return k
+    return None
+
+def vm_leaves(f, level=4, base=0, acc=PTE_RW | PTE_US):
+    """yield (vaddr, size, acc) for all the translations in the tree of
+level 'level' in frame f. acc contains the RW and US bits, anded along
+the path, as the MMU does"""
+    size = 1 << (12 + 9 * (level - 1))
+    for i, e in enumerate(read_tab(f)):
+        if not e & PTE_P:
+            continue
+        v = base + i * size
+        a = acc & e & (PTE_RW | PTE_US)
+        if level == 1 or (level < 4 and e & PTE_PS):
+            yield v, size, a
+        else:
+            yield from vm_leaves(e & pte_addr_mask, level - 1, v, a)
+
+def vm_maps(cr3):
+    """the regions of the address space rooted at cr3: lists of
+[start, end, part, acc, number of translations], where contiguous
+translations with the same access rights in the same part are merged"""
+    def read():
+        regions = []
+        for v, size, a in vm_leaves(cr3 & pte_addr_mask):
+            k = m_part(v)
+            r = regions[-1] if regions else None
+            if r and r[1] == v and r[2] == k and r[3] == a:
+                r[1] += size
+                r[4] += 1
+            else:
+                regions.append([v, v + size, k, a, 1])
+        return regions
+    return snap(('vm_maps', cr3), read)
+
+def acc_str(a):
+    return ('W' if a & PTE_RW else 'R') + ('U' if a & PTE_US else 'S')
+
+def vm_maps_json(pid, cr3):
+    return { 'pid': pid, 'cr3': "{:#x}".format(cr3),
+             'regioni': [ { 'inizio': "{:#x}".format(norm(b)), 'fine': "{:#x}".format(norm(e - 1) + 1),
+                            'parte': m_names[k] if k is not None else '?',
+                            'accesso': acc_str(a), 'traduzioni': n }
+                          for b, e, k, a, n in vm_maps(cr3) ] }
+
+class VmMaps(gdb.Command):
+    """show the memory map of a process.
+The argument can be any expression returning a process id or a des_proc*.
+If no arguments are given, 'esecuzione->id' is assumed.
+Each line shows a range of contiguous virtual addresses with the same
+access rights (R/W: read only/read-write, S/U: sistema/utente), the part
+of the address space it belongs to and the number of translations.
+With -json, write the map as a JSON object."""
+
+    def __init__(self, name):
+        super(VmMaps, self).__init__(name, gdb.COMMAND_DATA, gdb.COMPLETE_EXPRESSION)
+
+    def invoke(self, arg, from_tty):
+        j, arg = json_arg(arg)
+        p = parse_process(arg)
+        if not p:
+            raise gdb.GdbError("no such process")
+        pid, cr3 = toi(p['id']), toi(p['cr3'])
+        if j:
+            json_write(dict(command="vm_maps", **vm_maps_json(pid, cr3)))
+            return
+        for r in vm_maps_json(pid, cr3)['regioni']:
+            gdb.write(colorize('col_index', "{:>18s}-{:<18s} ".format(r['inizio'], r['fine'])) +
+                      "{} {:<17s} {:6d}\n".format(r['accesso'], r['parte'], r['traduzioni']))
+
+class Vm(gdb.Command):
+    """commands about virtual memory"""
+
+    def __init__(self):
+        super(Vm, self).__init__("vm", gdb.COMMAND_DATA, prefix=True)
+
+# libce-debug.py may have defined 'vm' already
+try:
+    gdb.execute("help vm", to_string=True)
+except gdb.error:
+    Vm()
+VmMaps("vm maps")
+
 class A_p(gdb.Command):
-    """show the contents of the a_p array"""
+    """show the contents of the a_p array.
+With -json, write the contents as a JSON object."""
 
     def __init__(self):
         super(A_p, self).__init__("a_p", gdb.COMMAND_DATA, prefix=False)
 
     def invoke(self, arg, from_tty):
-        a_p = gdb.parse_and_eval('a_p')
+        j, arg = json_arg(arg)
+        a_p = snap('a_p', lambda: read_array('a_p', 24))
+        if j:
+            json_write({ 'command': "a_p",
+                         'a_p': [ { 'irq': i, 'driver': True } if a == 1 else dict(irq=i, **proc_ref(snap_proc(a)))
+                                  for i, a in enumerate(a_p) if a ] })
+            return
         for i in range(24):
             if not a_p[i]:
                 continue
             s = 'DRIVER'
             if a_p[i] != 1:
-                s = "proc {}".format(a_p[i])
+                s = "proc {}".format(gdb.Value(a_p[i]).cast(des_proc_ptr_type))
             gdb.write("[{:2d}] {}\n".format(i, s))
 A_p()
+
+# QEMU snapshots (CESNAP).
+#
+# When the run script is asked to create a snapshot, it writes 'salva' in
+# SNAP_STATE. We then stop in io_pronto(), which main_sistema() calls right
+# after the I/O module has signalled sync_io, ask QEMU to save the whole
+# machine and let the guest go on. Later sessions restore the snapshot and
+# skip the whole initialization.
+SNAP_STATE = 'build/snap.stato'
+SNAP_TAG = 'nucleo'
+
+def snap_state():
+    """the snapshot mode chosen by the run script ('', 'salva' or 'ripristina')"""
+    try:
+        with open(SNAP_STATE) as f:
+            return f.read().strip()
+    except OSError:
+        return ''
+
+class SnapBreakpoint(gdb.Breakpoint):
+    """saves the snapshot once the I/O module is ready, without stopping"""
+
+    def __init__(self):
+        super(SnapBreakpoint, self).__init__('io_pronto', internal=True)
+        self.silent = True
+        self.done = False
+
+    def stop(self):
+        if self.done:
+            return False
+        self.done = True
+        out = gdb.execute('monitor savevm ' + SNAP_TAG, to_string=True)
+        if 'rror' in out:
+            gdb.write("istantanea non salvata: " + out.strip() + "\n", gdb.STDERR)
+        else:
+            gdb.write("istantanea '{}' salvata: le prossime sessioni ripartiranno da qui\n".format(SNAP_TAG))
+        return False
+
+if snap_state() == 'salva':
+    SnapBreakpoint()
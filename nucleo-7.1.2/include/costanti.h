@@ -25,6 +25,32 @@
 #define DIM_SYS_STACK		(4*KiB)
 /// numero massimo di PRD usati da dmaread/dmawrite
 #define MAX_PRD			16
+/// massimo numero di semafori passati a sem_wait_any()
+#define MAX_WAIT_ANY		16
+/// massimo numero di mailbox
+#define MAX_MBOX		64
+/// massimo numero di messaggi in coda in una mailbox
+#define MAX_MBOX_DIM		64
+/// dimensione massima dei messaggi copiati nel descrittore di messaggio
+#define MAX_MSG			128
+/// massimo numero di mutex per livello
+#define MAX_MUTEX		256
+/// durata del quanto di tempo, in intervalli del timer (0: nessun round-robin)
+#define QUANTO			0
+/// numero di eventi nel buffer di traccia del nucleo (potenza di 2)
+#define DIM_TRACCIA		4096
+/// numero di elementi della tabella del profilo a campionamento
+#define DIM_PROFILO		1024
+/// numero massimo di indirizzi registrati per ogni campione del profilo (1: solo RIP)
+#define PROF_PROFONDITA		8
+/// dimensione del buffer del log binario (si veda sysio.h)
+#define DIM_BLOG		(64*KiB)
+/// massimo numero di argomenti di un messaggio del log binario
+#define MAX_BLOG_ARGS		16
+/// massimo numero di processori usati, compreso quello di avvio (1: solo quello di avvio)
+#define MAX_CPU			8
+/// nessun processore preferito (si veda activate_p())
+#define CPU_QUALSIASI		0xFFFFFFFF
 
 /// @name Tipi delle primitive
 /// @{
@@ -41,6 +67,14 @@
 #define TIPO_D			0x25	///< delay()
 #define TIPO_L			0x26	///< do_log()
 #define TIPO_GMI		0x27	///< getmeminfo()
+#define TIPO_SF			0x28	///< sem_fini()
+#define TIPO_SN			0x29	///< sem_signal_n()
+#define TIPO_SSW		0x2A	///< sem_signal_wait()
+#define TIPO_WA			0x2B	///< sem_wait_any()
+#define TIPO_MI			0x2C	///< mbox_ini()
+#define TIPO_MS			0x2D	///< mbox_send()
+#define TIPO_MR			0x2E	///< mbox_recv()
+#define TIPO_MXI		0x2F	///< mutex_ini()
 /// @}
 
 /// @name Primitive riservate per il modulo I/O
@@ -54,6 +88,17 @@
 #define TIPO_IOP		0x34	///< io_panic()
 #define TIPO_TRA		0x35	///< trasforma()
 #define TIPO_ACC		0x36	///< access()
+#define TIPO_BLOG		0x37	///< blog()
+/// @}
+
+/// @name Altre primitive comuni
+///
+/// Tipi delle primitive dichiarate in `sys.h` che non hanno trovato
+/// posto tra i tipi 0x2-
+/// @{
+#define TIPO_MXL		0x38	///< mutex_lock()
+#define TIPO_MXU		0x39	///< mutex_unlock()
+#define TIPO_GPS		0x3A	///< getprocstat()
 /// @}
 
 /// @name Primitive fornite dal modulo I/O
@@ -75,7 +120,9 @@
 /// @{
 #define INTR_TIPO_KBD		0x50	///< tastiera
 #define INTR_TIPO_HD		0x60	///< hard disk
+#define INTR_TIPO_CPU		0xFD	///< richiesta di rischedulazione tra processori
 #define INTR_TIPO_TIMER		0xFE	///< timer (prio massima)
+#define INTR_TIPO_SPURIO	0xFF	///< interruzioni spurie dell'APIC locale
 /// @}
 
 /// @name Suddivisione della memoria virtuale.
@@ -17,10 +17,13 @@
  * @param a	parametro per il corpo del processo 
  * @param prio	priorità del processo 
  * @param liv	livello del processo (LIV_UTENTE o LIV_SISTEMA)
+ * @param cpu	processore su cui eseguire preferibilmente il processo
+ * 		(ignorato se non esiste)
  *
  * @return 	id del nuovo processo, o 0xFFFFFFFF in caso di errore
  */
-extern "C" natl activate_p(void f(natq), natq a, natl prio, natl liv);
+extern "C" natl activate_p(void f(natq), natq a, natl prio, natl liv,
+		natl cpu = CPU_QUALSIASI);
 
 /**
  * @brief Termina il processo corrente.
@@ -38,6 +41,20 @@ extern "C" void terminate_p();
  */
 extern "C" natl sem_ini(int val);
 
+/**
+ * @brief Distrugge un semaforo.
+ *
+ * Il descrittore del semaforo potrà essere riutilizzato da una successiva
+ * sem_ini(). L'id _sem_ non sarà più valido, anche se il descrittore viene
+ * riutilizzato.
+ *
+ * @param sem	id del semaforo
+ *
+ * @return	true se il semaforo è stato distrutto, false se ci sono
+ * 		processi bloccati sul semaforo
+ */
+extern "C" bool sem_fini(natl sem);
+
 /**
  * @brief Estrae un gettone da un semaforo.
  *
@@ -52,6 +69,110 @@ extern "C" void sem_wait(natl sem);
  */
 extern "C" void sem_signal(natl sem);
 
+/**
+ * @brief Inserisce più gettoni in un semaforo.
+ *
+ * Equivale a _n_ sem_signal() consecutive, ma con una sola invocazione
+ * del nucleo.
+ *
+ * @param sem	id del semaforo
+ * @param n	numero di gettoni da inserire
+ */
+extern "C" void sem_signal_n(natl sem, natl n);
+
+/**
+ * @brief Inserisce un gettone in un semaforo e ne estrae uno da un altro.
+ *
+ * Equivale a sem_signal(ss) seguita da sem_wait(sw), ma le due operazioni
+ * sono eseguite in modo atomico e con una sola invocazione del nucleo.
+ *
+ * @param ss	id del semaforo in cui inserire il gettone
+ * @param sw	id del semaforo da cui estrarre il gettone
+ */
+extern "C" void sem_signal_wait(natl ss, natl sw);
+
+/**
+ * @brief Estrae un gettone da uno qualunque tra più semafori.
+ *
+ * Se nessuno dei semafori contiene gettoni, il processo si blocca finché
+ * non ne viene inserito uno in uno qualunque di essi. I processi bloccati
+ * in sem_wait() sullo stesso semaforo hanno la precedenza.
+ *
+ * @param sems	array di id di semafori
+ * @param n	numero di elementi di _sems_ (al massimo MAX_WAIT_ANY)
+ *
+ * @return	posizione in _sems_ del semaforo da cui è stato estratto
+ * 		il gettone
+ */
+extern "C" natl sem_wait_any(const natl* sems, natl n);
+
+/**
+ * @brief Crea una nuova mailbox.
+ *
+ * @param dim	numero massimo di messaggi in coda (al massimo MAX_MBOX_DIM)
+ *
+ * @return 	id della nuova mailbox, o 0xFFFFFFFF in caso di errore
+ */
+extern "C" natl mbox_ini(natl dim);
+
+/**
+ * @brief Invia un messaggio a una mailbox.
+ *
+ * Se la mailbox è piena il processo si blocca. Se _buf_ è una pagina
+ * allineata di utente/privata e _len_ è DIM_PAGINA, il messaggio viene
+ * trasferito senza copiarlo e al ritorno la pagina risulta azzerata.
+ *
+ * @param mb	id della mailbox
+ * @param buf	messaggio da inviare
+ * @param len	lunghezza del messaggio (al massimo DIM_PAGINA)
+ *
+ * @return	false se il sistema non ha memoria sufficiente per il
+ * 		messaggio
+ */
+extern "C" bool mbox_send(natl mb, const void* buf, natq len);
+
+/**
+ * @brief Riceve un messaggio da una mailbox.
+ *
+ * Se la mailbox è vuota il processo si blocca. Se il messaggio è più lungo di
+ * _len_ la parte eccedente viene persa.
+ *
+ * @param mb	id della mailbox
+ * @param buf	buffer in cui ricevere il messaggio
+ * @param len	dimensione del buffer
+ *
+ * @return	numero di byte ricevuti
+ */
+extern "C" natq mbox_recv(natl mb, void* buf, natq len);
+
+/**
+ * @brief Crea un nuovo mutex.
+ *
+ * Un processo bloccato su un mutex cede la propria precedenza al processo che
+ * possiede il mutex, se questa è maggiore.
+ *
+ * @return 	id del nuovo mutex, o 0xFFFFFFFF in caso di errore
+ */
+extern "C" natl mutex_ini();
+
+/**
+ * @brief Acquisisce un mutex.
+ *
+ * Il processo si blocca se il mutex è posseduto da un altro processo.
+ *
+ * @param m	id del mutex
+ */
+extern "C" void mutex_lock(natl m);
+
+/**
+ * @brief Rilascia un mutex.
+ *
+ * Il mutex deve essere posseduto dal processo corrente.
+ *
+ * @param m	id del mutex
+ */
+extern "C" void mutex_unlock(natl m);
+
 /**
  * @brief Sospende il processo corrente.
  *
@@ -95,4 +216,41 @@ struct meminfo {
  * @return struttura contenente le informazioni
  */
 extern "C" meminfo getmeminfo();
+
+/// @brief Statistiche sull'uso del processore da parte di un processo
+///
+/// Tutti i tempi sono espressi in cicli del Time Stamp Counter.
+struct procstat {
+	/// tempo in esecuzione (compreso quello passato nel nucleo per conto
+	/// del processo)
+	natq cpu;
+	/// tempo passato in pronti dopo essere stato interrotto
+	natq pronto;
+	/// tempo passato bloccato su semafori, mutex o mailbox
+	natq sincr;
+	/// tempo passato sospeso in delay()
+	natq delay;
+	/// tempo passato fuori dal processore per altri motivi (per es. in
+	/// attesa di una interruzione)
+	natq altro;
+	/// numero di volte in cui il processo ha lasciato il processore
+	/// bloccandosi
+	natl cambi_volontari;
+	/// numero di volte in cui il processo ha lasciato il processore perché
+	/// interrotto (preemption o fine del quanto)
+	natl cambi_involontari;
+	/// numero di volte in cui il processo è ripartito su un processore
+	/// diverso dal precedente
+	natl migrazioni;
+};
+
+/**
+ * @brief Estrae le statistiche sull'uso del processore di un processo.
+ *
+ * @param id	id del processo
+ * @param ps	struttura da riempire
+ *
+ * @return	false se il processo non esiste
+ */
+extern "C" bool getprocstat(natl id, procstat* ps);
 /// @}
@@ -84,3 +84,42 @@ extern "C" bool access(const void* start, natq dim, bool writeable, bool shared
  * @return 		false in caso di errore, true altrimenti
  */
 extern "C" bool fill_gate(natl tipo, vaddr f);
+
+/**
+ * @brief Invia un messaggio al log binario.
+ *
+ * Il messaggio non viene formattato: si registrano solo la severità, l'id
+ * del processo, il valore del TSC, l'indirizzo del formato e gli argomenti.
+ * I messaggi vengono inviati sulla seconda porta seriale quando il sistema
+ * è inattivo e vanno decodificati con util/blog.pl, che ricava il formato
+ * (e le eventuali stringhe passate con `%s`) dagli eseguibili dei moduli.
+ *
+ * Se il modulo è compilato con la macro LOG_BINARIO (si veda la variabile
+ * CEBLOG nel Makefile) tutte le flog() del modulo usano questa primitiva.
+ *
+ * @param sev		severità del messaggio
+ * @param fmt		formato (stringa costante del modulo chiamante)
+ * @param n		numero di argomenti (al più @ref MAX_BLOG_ARGS)
+ * @param args		argomenti, convertiti in natq
+ */
+extern "C" void blog(log_sev sev, const char* fmt, natl n, const natq* args);
+
+#ifdef LOG_BINARIO
+/// @cond
+template<typename T>
+inline natq blog_arg(T v)
+{
+	return (natq)v;
+}
+
+template<typename... T>
+void flog_bin(log_sev sev, const char* fmt, T... args)
+{
+	static_assert(sizeof...(T) <= MAX_BLOG_ARGS, "troppi argomenti per blog()");
+	natq a[] = { 0, blog_arg(args)... };
+	blog(sev, fmt, sizeof...(T), a + 1);
+}
+
+#define flog(sev, ...) flog_bin(sev, __VA_ARGS__)
+/// @endcond
+#endif
@@ -20,12 +20,12 @@ extern "C" void panic(const char* msg);
 ///
 /// Dal momento che le funzioni del modulo I/O sono eseguite con le interruzioni
 /// esterne mascherabili abilitate, dobbiamo proteggere lo heap I/O con un
-/// semaforo di mutua esclusione.
+/// mutex.
 ///
 /// @{
 ////////////////////////////////////////////////////////////////////////////////
 
-/// Indice del semaforo di mutua esclusione per lo heap I/O
+/// Id del mutex per lo heap I/O
 natl ioheap_mutex;
 
 /*! @brief Alloca un oggetto nello heap I/O.
@@ -36,9 +36,9 @@ void* operator new(size_t s)
 {
 	void* p;
 
-	sem_wait(ioheap_mutex);
+	mutex_lock(ioheap_mutex);
 	p = alloc(s);
-	sem_signal(ioheap_mutex);
+	mutex_unlock(ioheap_mutex);
 
 	return p;
 }
@@ -52,9 +52,9 @@ void* operator new(size_t s, std::align_val_t a)
 {
 	void* p;
 
-	sem_wait(ioheap_mutex);
+	mutex_lock(ioheap_mutex);
 	p = alloc_aligned(s, a);
-	sem_signal(ioheap_mutex);
+	mutex_unlock(ioheap_mutex);
 	return p;
 }
 
@@ -63,9 +63,9 @@ void* operator new(size_t s, std::align_val_t a)
  */
 void operator delete(void* p)
 {
-	sem_wait(ioheap_mutex);
+	mutex_lock(ioheap_mutex);
 	dealloc(p);
-	sem_signal(ioheap_mutex);
+	mutex_unlock(ioheap_mutex);
 }
 /// @}
 
@@ -79,7 +79,7 @@ void operator delete(void* p)
 
 /// Descrittore della console
 struct des_console {
-	/// Semaforo di mutua esclusione per l'accesso alla console
+	/// Mutex per l'accesso alla console
 	natl mutex;
 	/// Semafor di sincronizzazione (per le letture da tastiera)
 	natl sincr;
@@ -107,7 +107,7 @@ extern "C" void c_writeconsole(const char* buff, natq quanti)
 		abort_p();
 	}
 
-	sem_wait(p_des->mutex);
+	mutex_lock(p_des->mutex);
 #ifndef AUTOCORR
 	for (natq i = 0; i < quanti; i++)
 		vid::char_write(buff[i]);
@@ -117,7 +117,7 @@ extern "C" void c_writeconsole(const char* buff, natq quanti)
 	if (quanti > 0)
 		flog(LOG_USR, "%.*s", static_cast<int>(quanti), buff);
 #endif /* AUTOCORR */
-	sem_signal(p_des->mutex);
+	mutex_unlock(p_des->mutex);
 }
 
 /*! @brief Avvia una operazione di lettura dalla tastiera
@@ -155,11 +155,11 @@ extern "C" natq c_readconsole(char* buff, natq quanti)
 	if (!quanti)
 		return 0;
 
-	sem_wait(d->mutex);
+	mutex_lock(d->mutex);
 	startkbd_in(d, buff, quanti);
 	sem_wait(d->sincr);
 	rv = d->dim - d->cont;
-	sem_signal(d->mutex);
+	mutex_unlock(d->mutex);
 	return rv;
 }
 
@@ -257,7 +257,7 @@ bool console_init()
 {
 	des_console* d = &console;
 
-	if ( (d->mutex = sem_ini(1)) == 0xFFFFFFFF) {
+	if ( (d->mutex = mutex_ini()) == 0xFFFFFFFF) {
 		flog(LOG_ERR, "console: impossibile creare mutex");
 		return false;
 	}
@@ -278,7 +278,7 @@ bool console_init()
 struct des_ata {
 	/// Ultimo comando inviato all'interfaccia
 	natb comando;
-	/// Indice di un semaforo di mutua esclusione
+	/// Id di un mutex
 	natl mutex;
 	/// Indice di un semaforo di sincronizzazione
 	natl sincr;
@@ -360,10 +360,10 @@ extern "C" void c_readhd_n(natb vetti[], natl primo, natb quanti)
 	if (!quanti)
 		return;
 
-	sem_wait(d->mutex);
+	mutex_lock(d->mutex);
 	starthd_in(d, vetti, primo, quanti);
 	sem_wait(d->sincr);
-	sem_signal(d->mutex);
+	mutex_unlock(d->mutex);
 }
 
 /*! @brief Avvia una operazione di uscita verso l'hard disk.
@@ -398,10 +398,10 @@ extern "C" void c_writehd_n(natb vetto[], natl primo, natb quanti)
 	if (!quanti)
 		return;
 
-	sem_wait(d->mutex);
+	mutex_lock(d->mutex);
 	starthd_out(d, vetto, primo, quanti);
 	sem_wait(d->sincr);
-	sem_signal(d->mutex);
+	mutex_unlock(d->mutex);
 }
 
 /*! @brief Avvia una operazione di ingresso in DMA dall'hard disk.
@@ -448,10 +448,10 @@ extern "C" void c_dmareadhd_n(natb vetti[], natl primo, natb quanti)
 	if (!quanti)
 		return;
 
-	sem_wait(d->mutex);
+	mutex_lock(d->mutex);
 	dmastarthd_in(d, vetti, primo, quanti);
 	sem_wait(d->sincr);
-	sem_signal(d->mutex);
+	mutex_unlock(d->mutex);
 }
 
 /*! @brief Avvia una operazione di uscita in DMA verso l'hard disk.
@@ -498,10 +498,10 @@ extern "C" void c_dmawritehd_n(natb vetto[], natl primo, natb quanti)
 	if (!quanti)
 		return;
 
-	sem_wait(d->mutex);
+	mutex_lock(d->mutex);
 	dmastarthd_out(d, vetto, primo, quanti);
 	sem_wait(d->sincr);
-	sem_signal(d->mutex);
+	mutex_unlock(d->mutex);
 }
 
 /// @brief Processo esterno per le richieste di interruzione dell'hard disk
@@ -544,7 +544,7 @@ bool hd_init()
 
 	d = &hard_disk;
 
-	if ( (d->mutex = sem_ini(1)) == 0xFFFFFFFF) {
+	if ( (d->mutex = mutex_ini()) == 0xFFFFFFFF) {
 		flog(LOG_ERR, "hd: impossibile creare mutex");
 		return false;
 	}
@@ -599,9 +599,9 @@ extern "C" void main(natq sem_io)
 {
 
 	fill_io_gates();
-	ioheap_mutex = sem_ini(1);
+	ioheap_mutex = mutex_ini();
 	if (ioheap_mutex == 0xFFFFFFFF) {
-		panic("impossible creare semaforo ioheap_mutex");
+		panic("impossible creare il mutex ioheap_mutex");
 	}
 	char* end_ = allinea_ptr(end, DIM_PAGINA);
 	heap_init(end_, DIM_IO_HEAP);
@@ -638,9 +638,9 @@ extern "C" void panic(const char* msg)
 extern "C" natq c_getiomeminfo()
 {
 	natq rv;
-	sem_wait(ioheap_mutex);
+	mutex_lock(ioheap_mutex);
 	rv = disponibile();
-	sem_signal(ioheap_mutex);
+	mutex_unlock(ioheap_mutex);
 	return rv;
 }
 /// @}
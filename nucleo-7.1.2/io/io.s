@@ -46,6 +46,13 @@ sem_ini:
 	ret
 	.cfi_endproc
 
+	.global sem_fini
+sem_fini:
+	.cfi_startproc
+	int $TIPO_SF
+	ret
+	.cfi_endproc
+
 	.global sem_wait
 sem_wait:
 	.cfi_startproc
@@ -60,6 +67,76 @@ sem_signal:
 	ret
 	.cfi_endproc
 
+	.global sem_signal_n
+sem_signal_n:
+	.cfi_startproc
+	int $TIPO_SN
+	ret
+	.cfi_endproc
+
+	.global sem_signal_wait
+sem_signal_wait:
+	.cfi_startproc
+	int $TIPO_SSW
+	ret
+	.cfi_endproc
+
+	.global sem_wait_any
+sem_wait_any:
+	.cfi_startproc
+	int $TIPO_WA
+	ret
+	.cfi_endproc
+
+	.global mbox_ini
+mbox_ini:
+	.cfi_startproc
+	int $TIPO_MI
+	ret
+	.cfi_endproc
+
+	.global mbox_send
+mbox_send:
+	.cfi_startproc
+	int $TIPO_MS
+	ret
+	.cfi_endproc
+
+	.global mbox_recv
+mbox_recv:
+	.cfi_startproc
+	int $TIPO_MR
+	ret
+	.cfi_endproc
+
+	.global mutex_ini
+mutex_ini:
+	.cfi_startproc
+	int $TIPO_MXI
+	ret
+	.cfi_endproc
+
+	.global mutex_lock
+mutex_lock:
+	.cfi_startproc
+	int $TIPO_MXL
+	ret
+	.cfi_endproc
+
+	.global mutex_unlock
+mutex_unlock:
+	.cfi_startproc
+	int $TIPO_MXU
+	ret
+	.cfi_endproc
+
+	.global getprocstat
+getprocstat:
+	.cfi_startproc
+	int $TIPO_GPS
+	ret
+	.cfi_endproc
+
 	.global delay
 delay:
 	.cfi_startproc
@@ -127,6 +204,13 @@ access:
 	ret
 	.cfi_endproc
 
+	.global blog
+blog:
+	.cfi_startproc
+	int $TIPO_BLOG
+	ret
+	.cfi_endproc
+
 // Chiama fill_gate con i parametri specificati
 .macro fill_io_gate gate off
 	movq $\gate, %rdi
@@ -62,6 +62,10 @@ const natl DUMMY_PRIORITY = 0;
 /// Numero di registri nel campo contesto del descrittore di processo
 const int N_REG = 16;
 
+/// @cond
+struct des_mutex;
+/// @endcond
+
 /// @brief Descrittore di processo
 struct des_proc {
 	/// identificatore numerico del processo
@@ -88,6 +92,54 @@ struct des_proc {
 	/// parametro `a` passato alla `activate_p`/`_pe` che ha creato questo processo
 	natq  parametro;
 	/// @}
+
+	/// @name Informazioni per l'ereditarietà della priorità (si veda @ref mutex)
+	/// @{
+
+	/// precedenza assegnata alla creazione (@ref precedenza può essere
+	/// maggiore, se ereditata)
+	natl precedenza_base;
+	/// mutex su cui il processo è bloccato (nullptr se nessuno)
+	des_mutex* mutex_atteso;
+	/// lista dei mutex posseduti dal processo
+	des_mutex* mutex_posseduti;
+	/// @}
+
+	/// @name Contabilità del tempo di CPU (si veda @ref c_driver_td)
+	/// @{
+
+	/// intervalli del timer terminati mentre il processo era in esecuzione
+	natq tick_cpu;
+	/// intervalli consumati del quanto di tempo corrente (se QUANTO > 0).
+	/// Azzerato ogni volta che il processo torna in esecuzione (si veda
+	/// contabilita())
+	natl tick_quanto;
+	/// statistiche basate sul TSC (si veda @ref contab)
+	procstat stat;
+	/// valore del TSC quando il processo ha lasciato il processore
+	natq tsc_uscita;
+	/// motivo per cui il processo ha lasciato il processore
+	natl attesa;
+	/// @}
+
+	/// @name Multiprocessore (si veda @ref smp)
+	/// @{
+
+	/// processore preferito, indicato in activate_p() (@ref CPU_QUALSIASI
+	/// se nessuno)
+	natl cpu_preferita;
+	/// processore su cui il processo è stato eseguito l'ultima volta
+	/// (@ref CPU_QUALSIASI se non è ancora stato eseguito)
+	natl ultima_cpu;
+	/// @}
+};
+
+/// @brief Valori del campo des_proc::attesa
+enum {
+	ATT_NESSUNA,	///< nessuno (o non noto)
+	ATT_PRONTO,	///< il processo è stato interrotto ed è in pronti
+	ATT_SINCR,	///< il processo è bloccato su un semaforo, mutex o mailbox
+	ATT_DELAY,	///< il processo è sospeso in delay()
 };
 
 /// @brief Tabella che associa l'id di un processo al corrispondente des_proc.
@@ -105,6 +157,19 @@ extern "C" void c_abort_p(bool selfdump = true);
 
 // (forward) Ferma tutto il sistema (in caso di bug nel sistema stesso)
 extern "C" [[noreturn]] void panic(const char* msg);
+
+// (forward) Controlla i buffer passati dal livello utente
+extern "C" bool c_access(vaddr begin, natq dim, bool writeable, bool shared);
+
+// (forward) Registra un campione del profilo (si veda @ref profilo)
+void campiona();
+
+// (forward) Invia il log binario sulla seconda porta seriale (si veda @ref blog)
+void blog_svuota();
+
+// (forward) Chiede a un altro processore di rischedulare (si veda @ref smp)
+struct des_cpu;
+void richiedi_rischedulazione(des_cpu* c);
 /// @endcond
 
 /// @brief Indici delle copie dei registri nell'array contesto
@@ -112,12 +177,116 @@ enum { I_RAX, I_RCX, I_RDX, I_RBX,
 	I_RSP, I_RBP, I_RSI, I_RDI, I_R8, I_R9, I_R10,
 	I_R11, I_R12, I_R13, I_R14, I_R15 };
 
-/// Coda esecuzione (contiene sempre un solo elemento)
+/// @brief Coda esecuzione (contiene sempre un solo elemento)
+///
+/// Con più processori (si veda @ref smp) contiene il processo del processore
+/// che possiede il big kernel lock.
 des_proc* esecuzione;
 
-/// Coda pronti (vuota solo quando dummy è in @ref esecuzione)
+/// @brief Coda pronti (vuota solo quando dummy è in @ref esecuzione)
+///
+/// Con più processori ogni processore ha la propria coda (des_cpu::pronti)
+/// e questa variabile contiene quella del processore che possiede il big
+/// kernel lock (si veda coda_pronti()).
 des_proc* pronti;
 
+/// @brief Descrittore di processore
+///
+/// Ogni processore ha il proprio processo in esecuzione e la propria coda
+/// pronti, che la bkl_acquisisci (in sistema.s) copia in @ref esecuzione e
+/// @ref pronti all'entrata nel nucleo e cpu_uscita() riporta qui all'uscita.
+struct des_cpu {
+	/// processo in esecuzione (deve essere il primo campo, si veda
+	/// ESECUZIONE_CPU in sistema.s)
+	des_proc* esecuzione;
+	/// coda pronti (deve essere il secondo campo, si veda PRONTI_CPU in
+	/// sistema.s)
+	des_proc* pronti;
+	/// identificatore dell'APIC locale
+	natl id_apic;
+	/// processo eseguito quando in @ref pronti non ci sono processi adatti
+	/// a questo processore (nullptr per il processore di avvio, che usa
+	/// @ref dummy)
+	des_proc* inattivo;
+	/// indirizzo fisico del puntatore alla pila sistema nel segmento TSS
+	paddr tss_punt_nucleo;
+	/// processo a cui stiamo addebitando il tempo (si veda @ref contab)
+	des_proc* in_carico;
+	/// valore del TSC all'ultima chiamata di contabilita()
+	natq ultimo_tsc;
+	/// processo che ha esaurito il quanto (si veda c_driver_td())
+	des_proc* scaduto;
+	/// processi presi dalle code pronti degli altri processori
+	natq rubati;
+	/// inviata una richiesta di rischedulazione non ancora servita
+	bool ipi;
+	/// id del processo che era in esecuzione all'ultima uscita dal nucleo
+	/// (si veda traccia_uscita())
+	natl traccia_id;
+	/// segmento TSS (solo per i processori secondari)
+	natl tss[26];
+};
+
+/// Descrittori dei processori (il primo è quello di avvio)
+des_cpu cpu[MAX_CPU];
+
+/// Descrittori dei processori, indicizzati con l'identificatore dell'APIC locale
+des_cpu* cpu_apic[256];
+
+/// Numero di processori attivi
+natl num_cpu = 1;
+
+/// Indirizzo fisico dei registri dell'APIC locale
+const paddr APIC_LOCALE = 0xFEE00000;
+
+/*! @brief Accede a un registro dell'APIC locale
+ *  @param reg	offset del registro
+ *  @return	puntatore al registro
+ */
+volatile natl* apic_locale(natl reg)
+{
+	return ptr_cast<volatile natl>(APIC_LOCALE + reg);
+}
+
+/// @brief Restituisce il descrittore del processore corrente
+des_cpu* cpu_corrente()
+{
+	if (num_cpu == 1)
+		return &cpu[0];
+	return cpu_apic[*apic_locale(0x20) >> 24];
+}
+
+/*! @brief Coda pronti di un processore
+ *  @param c	descrittore del processore
+ *  @return	@ref pronti se _c_ è il processore corrente, altrimenti
+ *  		des_cpu::pronti
+ */
+des_proc*& coda_pronti(des_cpu* c)
+{
+	return c == cpu_corrente() ? pronti : c->pronti;
+}
+
+/*! @brief Primo processo di una coda pronti che il processore può eseguire
+ *
+ *  Il processore di avvio può eseguire qualunque processo. Gli altri eseguono
+ *  solo processi utente: i processi di livello sistema (compresi quelli
+ *  esterni, che devono inviare l'EOI all'APIC locale del processore che
+ *  riceve le interruzioni) restano sul processore di avvio.
+ *
+ *  @param c		descrittore del processore
+ *  @param p_lista	coda in cui cercare
+ *  @return		processo trovato (nullptr se non ce ne sono)
+ */
+des_proc* primo_idoneo(des_cpu* c, des_proc* p_lista)
+{
+	if (!c->inattivo)
+		return p_lista;
+	des_proc* p = p_lista;
+	while (p && p->livello != LIV_UTENTE)
+		p = p->puntatore;
+	return p;
+}
+
 /*! @brief Inserimento in lista ordinato (per priorità)
  *  @param p_lista	lista in cui inserire
  *  @param p_elem	elemento da inserire
@@ -163,9 +332,48 @@ des_proc* rimozione_lista(des_proc*& p_lista)
 	return p_elem;
 }
 
+/*! @brief Estrazione di un processo qualunque
+ *  @param p_lista	lista da cui estrarre
+ *  @param p_elem	processo da estrarre (deve trovarsi in _p_lista_)
+ */
+void estrazione_lista(des_proc*& p_lista, des_proc* p_elem)
+{
+	des_proc** pp = &p_lista;
+
+	while (*pp != p_elem)
+		pp = &(*pp)->puntatore;
+
+	*pp = p_elem->puntatore;
+	p_elem->puntatore = nullptr;
+}
+
+/*! @brief Inserisce in una coda pronti un processo che torna pronto
+ *
+ *  I processi di livello sistema vanno nella coda del processore di avvio,
+ *  gli altri in quella del processore preferito (si veda activate_p()) o,
+ *  se non ne hanno uno, in quella del processore corrente.
+ *
+ *  @param p	processo da inserire
+ */
+void inserimento_pronti(des_proc* p)
+{
+	des_cpu* c;
+	if (p->livello != LIV_UTENTE)
+		c = &cpu[0];
+	else if (p->cpu_preferita < num_cpu)
+		c = &cpu[p->cpu_preferita];
+	else
+		c = cpu_corrente();
+	inserimento_lista(coda_pronti(c), p);
+}
+
 /// @brief Inserisce @ref esecuzione in testa alla lista @ref pronti
+///
+/// Il processo inattivo di un processore secondario non va mai in pronti.
 extern "C" void inspronti()
 {
+	if (esecuzione == cpu_corrente()->inattivo)
+		return;
 	esecuzione->puntatore = pronti;
 	pronti = esecuzione;
 }
@@ -175,11 +383,39 @@ extern "C" void inspronti()
  *  Il processo andrà effettivamente in esecuzione solo alla prossima
  *  `call carica_stato; iretq`
  */
+///
+/// Con più processori sceglie il processo a precedenza maggiore tra quelli
+/// che il processore può eseguire, in tutte le code pronti: a parità di
+/// precedenza preferisce quelli della propria coda. In particolare, un
+/// processore che altrimenti resterebbe inattivo prende il lavoro degli
+/// altri (work stealing).
 extern "C" void schedulatore(void)
 {
-// poiché la lista è già ordinata in base alla priorità,
-// è sufficiente estrarre l'elemento in testa
-	esecuzione = rimozione_lista(pronti);
+	des_cpu* c = cpu_corrente();
+	// poiché le code sono già ordinate in base alla priorità,
+	// è sufficiente guardare il primo processo adatto di ognuna
+	des_proc* p = primo_idoneo(c, pronti);
+	des_proc** p_lista = &pronti;
+	for (natl i = 0; i < num_cpu; i++) {
+		des_cpu* a = &cpu[i];
+		if (a == c)
+			continue;
+		des_proc* q = primo_idoneo(c, a->pronti);
+		if (q && (!p || q->precedenza > p->precedenza)) {
+			p = q;
+			p_lista = &a->pronti;
+		}
+	}
+	if (!p) {
+		// solo per i processori secondari (il processore di avvio
+		// ha sempre almeno dummy)
+		esecuzione = c->inattivo;
+		return;
+	}
+	if (p_lista != &pronti)
+		c->rubati++;
+	estrazione_lista(*p_lista, p);
+	esecuzione = p;
 }
 
 /*! @brief Trova il descrittore di processo dato l'id.
@@ -214,9 +450,12 @@ extern "C" void halt();
 /// @brief Corpo del processo dummy
 void dummy(natq)
 {
-	while (processi)
+	while (processi) {
+		blog_svuota();
 		halt();
+	}
 	flog(LOG_INFO, "Shutdown");
+	blog_svuota();
 	end_program();
 }
 
@@ -224,6 +463,264 @@ void dummy(natq)
 // si veda anche CREAZIONE E DISTRUZIONE DEI PROCESSI, più avanti
 /// @}
 
+/////////////////////////////////////////////////////////////////////////////////
+/// @defgroup traccia		Traccia degli eventi
+///
+/// Il nucleo registra gli eventi più importanti (entrate e uscite dal
+/// nucleo, cambi di processo, blocchi e risvegli sui semafori, allocazione
+/// e rilascio di frame) in un buffer circolare di @ref DIM_TRACCIA elementi,
+/// sovrascrivendo i più vecchi. Ogni evento è marcato con il valore del Time
+/// Stamp Counter e con il processore su cui si è verificato, in modo che la
+/// traccia si possa separare per processore.
+///
+/// Il nucleo esegue sempre con le interruzioni disabilitate e su un solo
+/// processore alla volta (si veda @ref smp), quindi per aggiungere un evento
+/// basta incrementare un contatore, senza bisogno di altri lock. La traccia
+/// si può leggere dal debugger (comando `traccia`), che può anche salvarla in
+/// un file per l'elaborazione fuori linea.
+/// @{
+/////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Tipi di evento
+enum tipo_evento {
+	EV_ENTRATA,		///< entrata nel nucleo (a: id, b: indirizzo nello stub)
+	EV_USCITA,		///< uscita dal nucleo (a: id del processo che riparte)
+	EV_CAMBIO,		///< cambio di processo (a: id uscente, b: id entrante)
+	EV_BLOCCO,		///< blocco su semaforo (a: id, b: indice del semaforo)
+	EV_RISVEGLIO,		///< risveglio da semaforo (a: id, b: indice del semaforo)
+	EV_ALLOCA_FRAME,	///< alloca_frame() (b: indirizzo del frame)
+	EV_RILASCIA_FRAME,	///< rilascia_frame() (b: indirizzo del frame)
+};
+
+/// @brief Elemento della traccia
+struct evento {
+	/// valore del TSC al momento dell'evento
+	natq tsc;
+	/// tipo_evento
+	natw tipo;
+	/// indice in @ref cpu del processore che ha registrato l'evento
+	natw cpu;
+	/// primo parametro (dipende dal tipo)
+	natl a;
+	/// secondo parametro (dipende dal tipo)
+	natq b;
+};
+
+/// Buffer circolare degli eventi
+evento traccia_buf[DIM_TRACCIA];
+
+/// Numero totale di eventi registrati (anche quelli sovrascritti)
+natq traccia_pos;
+
+/// Se false, non vengono registrati nuovi eventi (modificabile dal debugger)
+bool traccia_attiva = true;
+
+/// @brief Legge il Time Stamp Counter (definita in sistema.s)
+extern "C" natq leggi_tsc();
+
+/*! @brief Aggiunge un evento alla traccia
+ *  @param tipo	tipo dell'evento
+ *  @param a	primo parametro
+ *  @param b	secondo parametro
+ */
+void traccia(tipo_evento tipo, natl a, natq b = 0)
+{
+	if (!traccia_attiva)
+		return;
+
+	evento* e = &traccia_buf[traccia_pos % DIM_TRACCIA];
+	e->tsc = leggi_tsc();
+	e->tipo = tipo;
+	e->cpu = cpu_corrente() - cpu;
+	e->a = a;
+	e->b = b;
+	traccia_pos++;
+}
+
+/*! @brief Registra l'entrata nel nucleo (chiamata da salva_stato)
+ *  @param rip	indirizzo di ritorno da salva_stato (identifica lo stub, e
+ *  		quindi la primitiva o l'interruzione)
+ */
+extern "C" void traccia_entrata(vaddr rip)
+{
+	traccia(EV_ENTRATA, esecuzione->id, rip);
+}
+
+/*! @brief Registra l'uscita dal nucleo (chiamata da carica_stato)
+ *
+ *  Registra anche un evento EV_CAMBIO se il processo che riparte non è
+ *  quello che era in esecuzione su questo processore all'uscita precedente.
+ */
+extern "C" void traccia_uscita()
+{
+	des_cpu* c = cpu_corrente();
+	if (esecuzione->id != c->traccia_id) {
+		traccia(EV_CAMBIO, c->traccia_id, esecuzione->id);
+		c->traccia_id = esecuzione->id;
+	}
+	traccia(EV_USCITA, esecuzione->id);
+}
+/// @}
+
+/////////////////////////////////////////////////////////////////////////////////
+/// @defgroup blog		Log binario
+///
+/// La primitiva blog() (usata al posto di flog() se i moduli sono compilati
+/// con la macro LOG_BINARIO) non formatta il messaggio, ma ne copia
+/// l'indirizzo del formato e gli argomenti in un buffer circolare di @ref
+/// DIM_BLOG byte. Il processo dummy, quando il sistema è inattivo, invia il
+/// contenuto del buffer sulla seconda porta seriale (COM2). In questo modo
+/// anche molti messaggi di log alterano poco i tempi di esecuzione. Se il
+/// buffer è pieno i nuovi messaggi vengono scartati e contati; il numero di
+/// messaggi persi viene poi inviato al posto di un messaggio con formato
+/// nullo.
+///
+/// Ogni messaggio è formato da un @ref blog_rec seguito dagli argomenti
+/// (un natq ciascuno) e va decodificato fuori linea con util/blog.pl.
+///
+/// Nel buffer scrive solo il nucleo, a interruzioni disabilitate e con il big
+/// kernel lock (si veda @ref smp). Nel modulo sistema, però, blog() può
+/// essere chiamata anche dai processi main_sistema e dummy (tramite flog(),
+/// se il modulo è compilato con LOG_BINARIO), che eseguono a interruzioni
+/// abilitate: in quel caso blog() passa dalla primitiva (blog_primitiva()).
+///
+/// Legge solo il processo dummy, che non sovrascrive mai i byte non ancora
+/// inviati. Il nucleo aggiorna @ref blog_scritti solo dopo aver copiato i
+/// byte e dummy aggiorna @ref blog_letti solo dopo averli inviati: non
+/// servono altre sincronizzazioni.
+/// @{
+/////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Intestazione di un messaggio del log binario
+struct blog_rec {
+	/// sempre @ref BLOG_MAGIC (permette al decodificatore di risincronizzarsi)
+	natb magic;
+	/// severità
+	natb sev;
+	/// numero di argomenti che seguono l'intestazione
+	natb n;
+	/// non usato
+	natb pad;
+	/// id del processo in esecuzione
+	natl id;
+	/// valore del TSC
+	natq tsc;
+	/// indirizzo del formato (0: messaggi persi, il cui numero è nell'argomento)
+	vaddr fmt;
+};
+
+/// Valore del campo blog_rec::magic
+const natb BLOG_MAGIC = 0xB1;
+
+/// Buffer circolare del log binario
+natb blog_buf[DIM_BLOG];
+
+/// Numero totale di byte scritti in @ref blog_buf
+natq blog_scritti;
+
+/// Numero totale di byte inviati sulla porta seriale
+natq blog_letti;
+
+/// Numero di messaggi scartati perché il buffer era pieno
+natq blog_persi;
+
+/// @brief Indirizzo base della seconda porta seriale
+const ioaddr COM2 = 0x2F8;
+
+/*! @brief Copia byte nel buffer del log binario
+ *  @param src	indirizzo dei byte da copiare
+ *  @param len	numero di byte da copiare
+ */
+void blog_copia(const void* src, natq len)
+{
+	const natb* s = static_cast<const natb*>(src);
+	for (natq i = 0; i < len; i++)
+		blog_buf[(blog_scritti + i) % DIM_BLOG] = s[i];
+	// dummy può leggere i byte appena scritti solo dopo questo aggiornamento
+	__atomic_store_n(&blog_scritti, blog_scritti + len, __ATOMIC_RELEASE);
+}
+
+/*! @brief Scrive un messaggio nel buffer del log binario
+ *  @param sev	severità del messaggio
+ *  @param fmt	indirizzo del formato
+ *  @param n	numero di argomenti
+ *  @param args	argomenti
+ */
+void blog_scrivi(natb sev, vaddr fmt, natl n, const natq* args)
+{
+	blog_rec r;
+	r.magic = BLOG_MAGIC;
+	r.sev = sev;
+	r.n = n;
+	r.pad = 0;
+	r.id = esecuzione ? esecuzione->id : 0;
+	r.tsc = leggi_tsc();
+	r.fmt = fmt;
+	blog_copia(&r, sizeof(r));
+	blog_copia(args, n * sizeof(natq));
+}
+
+/// @brief Invoca la primitiva blog() (definita in sistema.s)
+extern "C" void blog_primitiva(log_sev sev, const char* fmt, natl n, const natq* args);
+
+/// @brief Legge il registro RFLAGS (definita in sistema.s)
+extern "C" natq leggi_rflags();
+
+// la parte C++ della primitiva è c_blog(), più avanti
+extern "C" void blog(log_sev sev, const char* fmt, natl n, const natq* args)
+{
+	// a interruzioni abilitate siamo in un processo del modulo sistema e
+	// non nel nucleo: passiamo dalla primitiva, che ci richiamerà
+	if (leggi_rflags() & BIT_IF) {
+		blog_primitiva(sev, fmt, n, args);
+		return;
+	}
+
+	natq len = sizeof(blog_rec) + n * sizeof(natq);
+	// se ci sono messaggi persi, serve spazio anche per segnalarli
+	if (blog_persi)
+		len += sizeof(blog_rec) + sizeof(natq);
+	if (blog_scritti - __atomic_load_n(&blog_letti, __ATOMIC_ACQUIRE) + len > DIM_BLOG) {
+		blog_persi++;
+		return;
+	}
+	if (blog_persi) {
+		blog_scrivi(LOG_WARN, 0, 1, &blog_persi);
+		blog_persi = 0;
+	}
+	blog_scrivi(sev, int_cast<vaddr>(fmt), n, args);
+}
+
+/// @brief Invia sulla seconda porta seriale il contenuto del buffer del log binario
+///
+/// Chiamata dal processo dummy e da panic().
+void blog_svuota()
+{
+	static bool com2_pronta = false;
+
+	if (blog_letti == __atomic_load_n(&blog_scritti, __ATOMIC_ACQUIRE))
+		return;
+
+	if (!com2_pronta) {
+		outputb(0x00, COM2 + 1);	// IER: nessuna interruzione
+		outputb(0x80, COM2 + 3);	// LCR: DLAB=1
+		outputb(0x01, COM2 + 0);	// DLL: 115200 bps
+		outputb(0x00, COM2 + 1);	// DLM
+		outputb(0x03, COM2 + 3);	// LCR: 8 bit, nessuna parità, 1 stop
+		outputb(0x07, COM2 + 2);	// FCR: abilita e svuota le FIFO
+		com2_pronta = true;
+	}
+	while (blog_letti != __atomic_load_n(&blog_scritti, __ATOMIC_ACQUIRE)) {
+		// attesa di THRE nel registro LSR
+		while (!(inputb(COM2 + 5) & 0x20))
+			;
+		outputb(blog_buf[blog_letti % DIM_BLOG], COM2);
+		// il nucleo può riusare il byte solo dopo questo aggiornamento
+		__atomic_store_n(&blog_letti, blog_letti + 1, __ATOMIC_RELEASE);
+	}
+}
+/// @}
+
 /////////////////////////////////////////////////////////////////////////////////
 /// @defgroup sem                   Semafori
 ///
@@ -231,6 +728,10 @@ void dummy(natq)
 /// @{
 /////////////////////////////////////////////////////////////////////////////////
 
+/// @cond
+struct nodo_attesa;
+/// @endcond
+
 /// @brief Descrittore di semaforo
 struct des_sem {
 	/// se >= 0, numero di gettoni contenuti;
@@ -238,134 +739,719 @@ struct des_sem {
 	int counter;
 	/// coda di processi bloccati sul semaforo
 	des_proc* pointer;
+	/// coda dei processi bloccati in sem_wait_any() anche su questo semaforo
+	nodo_attesa* attese;
+	/// true se il descrittore è in uso
+	bool allocato;
+	/// generazione del descrittore (incrementata da ogni sem_fini())
+	natl generazione;
+	/// prossimo descrittore libero (se il descrittore non è in uso)
+	natl prossimo_libero;
 };
 
+/// Numero totale di descrittori di semaforo (livello utente e sistema)
+const natl N_SEM = MAX_SEM * 2;
+
 /// @brief Array dei descrittori di semaforo.
 ///
 /// I primi MAX_SEM semafori di array_dess sono per il livello utente, gli altri
 /// MAX_SEM sono per il livello sistema.
-des_sem array_dess[MAX_SEM * 2];
+des_sem array_dess[N_SEM];
+
+/// @brief Numero di generazioni distinte per ogni descrittore di semaforo
+///
+/// L'id di un semaforo codifica sia l'indice del descrittore in @ref
+/// array_dess, sia la generazione del descrittore al momento della sem_ini():
+///
+///	id = indice + generazione * N_SEM
+///
+/// In questo modo, un id ottenuto prima di una sem_fini() non è più valido
+/// anche se il descrittore è stato nel frattempo riassegnato. Le generazioni
+/// sono limitate in modo che nessun id possa valere 0xFFFFFFFF.
+const natl MAX_GEN_SEM = 0xFFFFFFFF / N_SEM;
+
+/*! @brief Restituisce il livello a cui si trovava il processore al momento
+ *  in cui è stata invocata la primitiva.
+ *
+ *  @warning funziona solo nelle routine di risposta ad una interruzione
+ *  (INT, esterna o eccezione) se è stata chiamata `salva_stato`.
+ */
+int liv_chiamante()
+{
+	// salva_stato ha salvato il puntatore alla pila sistema
+	// subito dopo l'invocazione della INT
+	natq* pila = ptr_cast<natq>(esecuzione->contesto[I_RSP]);
+	// la seconda parola dalla cima della pila contiene il livello
+	// di privilegio che aveva il processore prima della INT
+	return pila[1] == SEL_CODICE_SISTEMA ? LIV_SISTEMA : LIV_UTENTE;
+}
+
+/// Numero di descrittori mai usati finora per il livello utente
+natl sem_allocati_utente  = 0;
+
+/// Numero di descrittori mai usati finora per il livello sistema (moduli sistema e I/O)
+natl sem_allocati_sistema = 0;
+
+/// Lista dei descrittori liberati dal livello utente (0xFFFFFFFF se vuota)
+natl sem_liberi_utente = 0xFFFFFFFF;
+
+/// Lista dei descrittori liberati dal livello sistema (0xFFFFFFFF se vuota)
+natl sem_liberi_sistema = 0xFFFFFFFF;
+
+/*! @brief Estrae l'indice in @ref array_dess da un id di semaforo
+ *  @param sem	id del semaforo
+ *  @return	indice del descrittore
+ */
+natl sem_indice(natl sem)
+{
+	return sem % N_SEM;
+}
+
+/*! @brief Alloca un nuovo semaforo.
+ *
+ *  @return id del nuovo semaforo (0xFFFFFFFF se esauriti)
+ */
+natl alloca_sem()
+{
+	// Ogni livello ha la sua lista di descrittori liberati da sem_fini().
+	// Se la lista è vuota usiamo il primo descrittore mai usato, che
+	// possiamo trovare semplicemente ricordando quanti ne abbiamo già
+	// usati (variabili sem_allocati_utente e sem_allocati_sistema).
+
+	int liv = liv_chiamante();
+	natl& liberi   = (liv == LIV_UTENTE ? sem_liberi_utente : sem_liberi_sistema);
+	natl& allocati = (liv == LIV_UTENTE ? sem_allocati_utente : sem_allocati_sistema);
+	natl i;
+	if (liberi != 0xFFFFFFFF) {
+		i = liberi;
+		liberi = array_dess[i].prossimo_libero;
+	} else {
+		if (allocati >= MAX_SEM)
+			return 0xFFFFFFFF;
+		i = allocati + (liv == LIV_UTENTE ? 0 : MAX_SEM);
+		allocati++;
+	}
+
+	des_sem* s = &array_dess[i];
+	s->allocato = true;
+	s->pointer = nullptr;
+	s->attese = nullptr;
+	return i + s->generazione * N_SEM;
+}
+
+/*! @brief Restituisce un descrittore di semaforo alla lista del suo livello
+ *  @param i	indice del descrittore in @ref array_dess
+ */
+void rilascia_sem(natl i)
+{
+	des_sem* s = &array_dess[i];
+	natl& liberi = (i < MAX_SEM ? sem_liberi_utente : sem_liberi_sistema);
+
+	s->allocato = false;
+	// invalidiamo tutti gli id che si riferiscono al descrittore
+	s->generazione = (s->generazione + 1) % MAX_GEN_SEM;
+	s->prossimo_libero = liberi;
+	liberi = i;
+}
+
+/*! @brief Verifica un id di semaforo
+ *
+ *  @param sem	id da verificare
+ *  @return  true se sem è l'id di un semaforo allocato; false altrimenti
+ */
+bool sem_valido(natl sem)
+{
+	// l'id è valido se il descrittore corrispondente è in uso e non è
+	// stato riassegnato dopo la sem_ini() che ha restituito l'id
+
+	natl i = sem_indice(sem);
+	if (i >= MAX_SEM && liv_chiamante() == LIV_UTENTE)
+		return false;
+
+	des_sem* s = &array_dess[i];
+	return s->allocato && s->generazione == sem / N_SEM;
+}
+
+/// @cond
+struct des_attesa;
+/// @endcond
+
+/// @brief Elemento di una coda di attesa multipla
+///
+/// Un processo bloccato in sem_wait_any() si trova contemporaneamente nelle
+/// code @ref des_sem::attese di tutti i semafori su cui è in attesa, tramite
+/// un nodo_attesa per ogni semaforo.
+struct nodo_attesa {
+	/// attesa a cui appartiene il nodo
+	des_attesa* attesa;
+	/// prossimo nodo nella coda del semaforo
+	nodo_attesa* succ;
+};
+
+/// @brief Attesa di un processo su più semafori (si veda sem_wait_any())
+struct des_attesa {
+	/// processo bloccato
+	des_proc* pp;
+	/// numero di semafori
+	natl n;
+	/// indici in @ref array_dess dei descrittori dei semafori
+	natl sem[MAX_WAIT_ANY];
+	/// nodi da inserire nelle code dei semafori (nodi[k] per sem[k])
+	nodo_attesa nodi[MAX_WAIT_ANY];
+};
+
+/*! @brief Inserimento ordinato (per priorità) in una coda di attesa multipla
+ *  @param p_lista	coda in cui inserire
+ *  @param p_elem	nodo da inserire
+ *  @note come inserimento_lista(), a parità di priorità favorisce i processi
+ *  già in coda
+ */
+void inserimento_attese(nodo_attesa*& p_lista, nodo_attesa* p_elem)
+{
+	natl prio = p_elem->attesa->pp->precedenza;
+	nodo_attesa *pp = p_lista, *prevp = nullptr;
+
+	while (pp && pp->attesa->pp->precedenza >= prio) {
+		prevp = pp;
+		pp = pp->succ;
+	}
+
+	p_elem->succ = pp;
+
+	if (prevp)
+		prevp->succ = p_elem;
+	else
+		p_lista = p_elem;
+}
+
+/*! @brief Estrae un nodo da una coda di attesa multipla
+ *  @param p_lista	coda da cui estrarre
+ *  @param p_elem	nodo da estrarre (deve trovarsi in _p_lista_)
+ */
+void estrazione_attese(nodo_attesa*& p_lista, nodo_attesa* p_elem)
+{
+	nodo_attesa** pp = &p_lista;
+
+	while (*pp != p_elem)
+		pp = &(*pp)->succ;
+
+	*pp = p_elem->succ;
+}
+
+/*! @brief Risveglia un processo bloccato in sem_wait_any()
+ *
+ *  Il processo viene tolto da tutte le code di attesa multipla e
+ *  inserito in @ref pronti.
+ *
+ *  @param nodo	nodo del semaforo che ha fornito il gettone
+ */
+void risveglia_attesa(nodo_attesa* nodo)
+{
+	des_attesa* a = nodo->attesa;
+
+	for (natl k = 0; k < a->n; k++) {
+		estrazione_attese(array_dess[a->sem[k]].attese, &a->nodi[k]);
+		// la sem_wait_any() restituisce la posizione del semaforo
+		if (&a->nodi[k] == nodo)
+			a->pp->contesto[I_RAX] = k;
+	}
+	inserimento_pronti(a->pp);
+	delete a;
+}
+
+/*! @brief Inserisce un gettone in un semaforo
+ *
+ *  Se ci sono processi in attesa, il gettone viene consumato subito e il
+ *  processo risvegliato viene inserito in @ref pronti. I processi bloccati
+ *  in sem_wait() hanno la precedenza su quelli bloccati in sem_wait_any().
+ *
+ *  @param i	indice del descrittore in @ref array_dess
+ */
+void sem_deposita(natl i)
+{
+	des_sem* s = &array_dess[i];
+	s->counter++;
+
+	if (s->counter <= 0) {
+		des_proc* lavoro = rimozione_lista(s->pointer);
+		traccia(EV_RISVEGLIO, lavoro->id, i);
+		inserimento_pronti(lavoro);
+	} else if (s->attese) {
+		// i processi in s->attese non sono contati in s->counter
+		s->counter--;
+		risveglia_attesa(s->attese);
+	}
+}
+
+/*! @brief Parte C++ della primitiva sem_ini().
+ *  @param val	numero di gettoni iniziali
+ */
+extern "C" void c_sem_ini(int val)
+{
+	natl i = alloca_sem();
+
+	if (i != 0xFFFFFFFF)
+		array_dess[sem_indice(i)].counter = val;
+
+	esecuzione->contesto[I_RAX] = i;
+}
+
+/*! @brief Parte C++ della primitiva sem_fini().
+ *  @param sem id di semaforo
+ */
+extern "C" void c_sem_fini(natl sem)
+{
+	esecuzione->contesto[I_RAX] = false;
+
+	// una primitiva non deve mai fidarsi dei parametri
+	if (!sem_valido(sem)) {
+		flog(LOG_WARN, "semaforo errato: %u", sem);
+		c_abort_p();
+		return;
+	}
+
+	// non possiamo distruggere un semaforo su cui qualcuno è bloccato
+	natl i = sem_indice(sem);
+	if (array_dess[i].pointer || array_dess[i].attese) {
+		flog(LOG_WARN, "sem_fini: semaforo %u con processi in coda", sem);
+		return;
+	}
+
+	rilascia_sem(i);
+	esecuzione->contesto[I_RAX] = true;
+}
+
+/*! @brief Parte C++ della primitiva sem_wait().
+ *  @param sem id di semaforo
+ */
+extern "C" void c_sem_wait(natl sem)
+{
+	// una primitiva non deve mai fidarsi dei parametri
+	if (!sem_valido(sem)) {
+		flog(LOG_WARN, "semaforo errato: %u", sem);
+		c_abort_p();
+		return;
+	}
+
+	des_sem* s = &array_dess[sem_indice(sem)];
+	s->counter--;
+
+	if (s->counter < 0) {
+		traccia(EV_BLOCCO, esecuzione->id, sem_indice(sem));
+		esecuzione->attesa = ATT_SINCR;
+		inserimento_lista(s->pointer, esecuzione);
+		schedulatore();
+	}
+}
+
+/*! @brief Parte C++ della primitiva sem_signal().
+ *  @param sem id di semaforo
+ */
+extern "C" void c_sem_signal(natl sem)
+{
+	// una primitiva non deve mai fidarsi dei parametri
+	if (!sem_valido(sem)) {
+		flog(LOG_WARN, "semaforo errato: %u", sem);
+		c_abort_p();
+		return;
+	}
+
+	natl i = sem_indice(sem);
+	des_sem* s = &array_dess[i];
+	if (s->counter < 0 || s->attese) {
+		// sem_deposita() risveglierà un processo
+		inspronti();	// preemption
+		sem_deposita(i);
+		schedulatore();	// preemption
+	} else {
+		s->counter++;
+	}
+}
+
+/*! @brief Parte C++ della primitiva sem_signal_n().
+ *  @param sem	id di semaforo
+ *  @param n	numero di gettoni da inserire
+ */
+extern "C" void c_sem_signal_n(natl sem, natl n)
+{
+	// una primitiva non deve mai fidarsi dei parametri
+	if (!sem_valido(sem)) {
+		flog(LOG_WARN, "semaforo errato: %u", sem);
+		c_abort_p();
+		return;
+	}
+
+	natl i = sem_indice(sem);
+	des_sem* s = &array_dess[i];
+	if (static_cast<long>(s->counter) + n > 0x7FFFFFFF) {
+		flog(LOG_WARN, "sem_signal_n: troppi gettoni (%d + %u)", s->counter, n);
+		c_abort_p();
+		return;
+	}
+
+	// un solo passaggio dallo schedulatore per tutti i processi
+	// risvegliati. I gettoni che nessuno aspetta vengono
+	// aggiunti tutti insieme.
+	inspronti();	// preemption
+	natl k;
+	for (k = 0; k < n && (s->counter < 0 || s->attese); k++)
+		sem_deposita(i);
+	s->counter += n - k;
+	schedulatore();	// preemption
+}
+
+/*! @brief Parte C++ della primitiva sem_signal_wait().
+ *  @param ss	id del semaforo su cui eseguire la signal
+ *  @param sw	id del semaforo su cui eseguire la wait
+ */
+extern "C" void c_sem_signal_wait(natl ss, natl sw)
+{
+	// una primitiva non deve mai fidarsi dei parametri
+	if (!sem_valido(ss) || !sem_valido(sw)) {
+		flog(LOG_WARN, "semafori errati: %u, %u", ss, sw);
+		c_abort_p();
+		return;
+	}
+
+	inspronti();	// preemption
+	sem_deposita(sem_indice(ss));
+
+	des_sem* s = &array_dess[sem_indice(sw)];
+	s->counter--;
+
+	if (s->counter < 0) {
+		// esecuzione si trova in pronti, in testa o subito dopo
+		// il processo eventualmente risvegliato dalla signal
+		estrazione_lista(pronti, esecuzione);
+		traccia(EV_BLOCCO, esecuzione->id, sem_indice(sw));
+		esecuzione->attesa = ATT_SINCR;
+		inserimento_lista(s->pointer, esecuzione);
+	}
+	schedulatore();
+}
+
+/*! @brief Parte C++ della primitiva sem_wait_any().
+ *  @param sems	array di id di semaforo
+ *  @param n	numero di elementi di _sems_
+ */
+extern "C" void c_sem_wait_any(const natl* sems, natl n)
+{
+	// una primitiva non deve mai fidarsi dei parametri
+	if (n == 0 || n > MAX_WAIT_ANY) {
+		flog(LOG_WARN, "sem_wait_any: numero di semafori errato: %u", n);
+		c_abort_p();
+		return;
+	}
+
+	if (liv_chiamante() == LIV_UTENTE &&
+		!c_access(int_cast<vaddr>(sems), n * sizeof(natl), false, false))
+	{
+		flog(LOG_WARN, "sem_wait_any: parametri non validi: %p", sems);
+		c_abort_p();
+		return;
+	}
+
+	// sems può trovarsi in memoria condivisa, che i processi in esecuzione
+	// sugli altri processori possono modificare in qualunque momento:
+	// leggiamo gli id una sola volta e, da qui in poi, usiamo solo la copia
+	natl ids[MAX_WAIT_ANY];
+	memcpy(ids, sems, n * sizeof(natl));
+
+	for (natl k = 0; k < n; k++) {
+		if (!sem_valido(ids[k])) {
+			flog(LOG_WARN, "semaforo errato: %u", ids[k]);
+			c_abort_p();
+			return;
+		}
+	}
+
+	// se uno dei semafori contiene gettoni non c'è bisogno di bloccarsi
+	for (natl k = 0; k < n; k++) {
+		des_sem* s = &array_dess[sem_indice(ids[k])];
+		if (s->counter > 0) {
+			s->counter--;
+			esecuzione->contesto[I_RAX] = k;
+			return;
+		}
+	}
+
+	des_attesa* a = new des_attesa;
+	if (!a) {
+		flog(LOG_WARN, "sem_wait_any: memoria esaurita");
+		c_abort_p();
+		return;
+	}
+	a->pp = esecuzione;
+	a->n = n;
+	esecuzione->attesa = ATT_SINCR;
+	for (natl k = 0; k < n; k++) {
+		a->sem[k] = sem_indice(ids[k]);
+		a->nodi[k].attesa = a;
+		inserimento_attese(array_dess[a->sem[k]].attese, &a->nodi[k]);
+	}
+	schedulatore();
+}
+/// @}
+
+/////////////////////////////////////////////////////////////////////////////////
+/// @defgroup mutex		Mutex con ereditarietà della priorità
+///
+/// Un mutex è simile a un semaforo di mutua esclusione, ma ricorda quale
+/// processo lo possiede. Quando un processo si blocca su un mutex, il
+/// proprietario eredita la sua precedenza, se maggiore. In questo modo il
+/// proprietario non può essere scavalcato da processi di precedenza
+/// intermedia mentre un processo più importante lo aspetta. L'ereditarietà è
+/// transitiva: se il proprietario è a sua volta bloccato su un altro mutex,
+/// la precedenza si propaga al proprietario di quest'ultimo, e così via.
+///
+/// La precedenza ereditata viene usata per riordinare il processo in @ref
+/// pronti e nelle code dei mutex. Se il processo si trova nella coda di un
+/// semaforo o del timer, la nuova precedenza vale solo dal prossimo
+/// inserimento in una coda.
+/// @{
+/////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Descrittore di mutex
+struct des_mutex {
+	/// processo che possiede il mutex (nullptr se il mutex è libero)
+	des_proc* proprietario;
+	/// coda di processi bloccati sul mutex
+	des_proc* pointer;
+	/// prossimo mutex posseduto dallo stesso processo
+	des_mutex* prossimo;
+};
+
+/// @brief Array dei descrittori di mutex.
+///
+/// I primi MAX_MUTEX mutex di array_desm sono per il livello utente, gli altri
+/// MAX_MUTEX sono per il livello sistema.
+des_mutex array_desm[MAX_MUTEX * 2];
+
+/// Numero di mutex allocati per il livello utente
+natl mutex_allocati_utente  = 0;
+
+/// Numero di mutex allocati per il livello sistema (moduli sistema e I/O)
+natl mutex_allocati_sistema = 0;
 
-/*! @brief Restituisce il livello a cui si trovava il processore al momento
- *  in cui è stata invocata la primitiva.
+/*! @brief Verifica un id di mutex
  *
- *  @warning funziona solo nelle routine di risposta ad una interruzione
- *  (INT, esterna o eccezione) se è stata chiamata `salva_stato`.
+ *  @param m	id da verificare
+ *  @return  true se m è l'id di un mutex allocato; false altrimenti
  */
-int liv_chiamante()
+bool mutex_valido(natl m)
 {
-	// salva_stato ha salvato il puntatore alla pila sistema
-	// subito dopo l'invocazione della INT
-	natq* pila = ptr_cast<natq>(esecuzione->contesto[I_RSP]);
-	// la seconda parola dalla cima della pila contiene il livello
-	// di privilegio che aveva il processore prima della INT
-	return pila[1] == SEL_CODICE_SISTEMA ? LIV_SISTEMA : LIV_UTENTE;
+	if (liv_chiamante() == LIV_UTENTE)
+		return m < mutex_allocati_utente;
+
+	return (m >= MAX_MUTEX && m < MAX_MUTEX + mutex_allocati_sistema);
 }
 
-/// Numero di semafori allocati per il livello utente
-natl sem_allocati_utente  = 0;
+/*! @brief Calcola la precedenza di un processo che possiede dei mutex
+ *  @param p	processo
+ *  @return	massimo tra la precedenza di base di _p_ e le precedenze dei
+ *  		processi bloccati sui mutex posseduti da _p_
+ */
+natl precedenza_ereditata(des_proc* p)
+{
+	natl prio = p->precedenza_base;
 
-/// Numero di semafori allocati per il livello sistema (moduli sistema e I/O)
-natl sem_allocati_sistema = 0;
+	// le code sono ordinate, quindi basta guardare il primo processo
+	for (des_mutex* m = p->mutex_posseduti; m; m = m->prossimo)
+		if (m->pointer && m->pointer->precedenza > prio)
+			prio = m->pointer->precedenza;
 
-/*! @brief Alloca un nuovo semaforo.
- *
- *  @return id del nuovo semaforo (0xFFFFFFFF se esauriti)
+	return prio;
+}
+
+/*! @brief Controlla se un processo si trova in una lista
+ *  @param p_lista	lista da controllare
+ *  @param p_elem	processo da cercare
+ *  @return		true se _p_elem_ si trova in _p_lista_
  */
-natl alloca_sem()
+bool in_lista(des_proc* p_lista, des_proc* p_elem)
 {
-	// I semafori non vengono mai deallocati, quindi è possibile allocarli
-	// sequenzialmente. Per far questo è sufficiente ricordare quanti ne
-	// abbiamo già allocati (variabili sem_allocati_utente e
-	// sem_allocati_sistema)
+	for (des_proc* p = p_lista; p; p = p->puntatore)
+		if (p == p_elem)
+			return true;
+	return false;
+}
 
-	int liv = liv_chiamante();
-	natl i;
-	if (liv == LIV_UTENTE) {
-		if (sem_allocati_utente >= MAX_SEM)
-			return 0xFFFFFFFF;
-		i = sem_allocati_utente;
-		sem_allocati_utente++;
-	} else {
-		if (sem_allocati_sistema >= MAX_SEM)
-			return 0xFFFFFFFF;
-		i = sem_allocati_sistema + MAX_SEM;
-		sem_allocati_sistema++;
+/*! @brief Ricalcola la precedenza di un processo e dei processi da cui
+ *  questo è bloccato.
+ *
+ *  Segue la catena proprietario -> mutex atteso -> proprietario ...
+ *  finché la precedenza dei processi incontrati non cambia più.
+ *
+ *  @param p	primo processo della catena
+ */
+void aggiorna_precedenza(des_proc* p)
+{
+	while (p) {
+		natl prio = precedenza_ereditata(p);
+		if (prio == p->precedenza)
+			return;
+		p->precedenza = prio;
+
+		des_mutex* m = p->mutex_atteso;
+		if (!m) {
+			// p può trovarsi anche in una coda che non riordiniamo
+			// (si veda la descrizione del gruppo)
+			for (natl i = 0; i < num_cpu; i++) {
+				des_proc*& q = coda_pronti(&cpu[i]);
+				if (in_lista(q, p)) {
+					estrazione_lista(q, p);
+					inserimento_lista(q, p);
+					break;
+				}
+			}
+			return;
+		}
+		estrazione_lista(m->pointer, p);
+		inserimento_lista(m->pointer, p);
+		p = m->proprietario;
 	}
-	return i;
 }
 
-/*! @brief Verifica un id di semaforo
+/*! @brief Assegna un mutex a un processo
+ *  @param m	mutex (libero)
+ *  @param p	nuovo proprietario
+ */
+void acquisisci_mutex(des_mutex* m, des_proc* p)
+{
+	m->proprietario = p;
+	m->prossimo = p->mutex_posseduti;
+	p->mutex_posseduti = m;
+}
+
+/*! @brief Toglie un mutex al suo proprietario e lo passa al primo processo
+ *  in coda, se ce n'è uno.
  *
- *  @param sem	id da verificare
- *  @return  true se sem è l'id di un semaforo allocato; false altrimenti
+ *  Non modifica la precedenza del vecchio proprietario.
+ *
+ *  @param m	mutex
+ *  @return	processo che ha ottenuto il mutex (nullptr se nessuno), da
+ *  		inserire in @ref pronti
  */
-bool sem_valido(natl sem)
+des_proc* cedi_mutex(des_mutex* m)
 {
-	// dal momento che i semafori non vengono mai deallocati,
-	// un semaforo è valido se e solo se il suo indice è inferiore
-	// al numero dei semafori allocati
+	des_mutex** pm = &m->proprietario->mutex_posseduti;
+	while (*pm != m)
+		pm = &(*pm)->prossimo;
+	*pm = m->prossimo;
+	m->proprietario = nullptr;
+	m->prossimo = nullptr;
+
+	des_proc* lavoro = rimozione_lista(m->pointer);
+	if (lavoro) {
+		lavoro->mutex_atteso = nullptr;
+		acquisisci_mutex(m, lavoro);
+		// il nuovo proprietario eredita dai processi ancora in coda
+		lavoro->precedenza = precedenza_ereditata(lavoro);
+	}
+	return lavoro;
+}
 
-	int liv = liv_chiamante();
-	return sem < sem_allocati_utente ||
-		(liv == LIV_SISTEMA && sem - MAX_SEM < sem_allocati_sistema);
+/*! @brief Rilascia tutti i mutex posseduti da un processo che termina
+ *  @param p	processo
+ */
+void rilascia_mutex(des_proc* p)
+{
+	while (des_mutex* m = p->mutex_posseduti) {
+		flog(LOG_WARN, "mutex %ld rilasciato per terminazione",
+				m - array_desm);
+		if (des_proc* lavoro = cedi_mutex(m))
+			inserimento_pronti(lavoro);
+	}
 }
 
-/*! @brief Parte C++ della primitiva sem_ini().
- *  @param val	numero di gettoni iniziali
+/*! @brief Parte C++ della primitiva mutex_ini().
  */
-extern "C" void c_sem_ini(int val)
+extern "C" void c_mutex_ini()
 {
-	natl i = alloca_sem();
+	natl i = 0xFFFFFFFF;
 
-	if (i != 0xFFFFFFFF)
-		array_dess[i].counter = val;
+	if (liv_chiamante() == LIV_UTENTE) {
+		if (mutex_allocati_utente < MAX_MUTEX)
+			i = mutex_allocati_utente++;
+	} else {
+		if (mutex_allocati_sistema < MAX_MUTEX)
+			i = MAX_MUTEX + mutex_allocati_sistema++;
+	}
 
 	esecuzione->contesto[I_RAX] = i;
 }
 
-/*! @brief Parte C++ della primitiva sem_wait().
- *  @param sem id di semaforo
+/*! @brief Parte C++ della primitiva mutex_lock().
+ *  @param m	id del mutex
  */
-extern "C" void c_sem_wait(natl sem)
+extern "C" void c_mutex_lock(natl m)
 {
 	// una primitiva non deve mai fidarsi dei parametri
-	if (!sem_valido(sem)) {
-		flog(LOG_WARN, "semaforo errato: %u", sem);
+	if (!mutex_valido(m)) {
+		flog(LOG_WARN, "mutex errato: %u", m);
 		c_abort_p();
 		return;
 	}
 
-	des_sem* s = &array_dess[sem];
-	s->counter--;
+	des_mutex* mx = &array_desm[m];
+	if (!mx->proprietario) {
+		acquisisci_mutex(mx, esecuzione);
+		return;
+	}
 
-	if (s->counter < 0) {
-		inserimento_lista(s->pointer, esecuzione);
-		schedulatore();
+	// se il proprietario aspetta (direttamente o indirettamente)
+	// un mutex posseduto da esecuzione, nessuno dei due potrà
+	// mai proseguire
+	for (des_proc* p = mx->proprietario; p;
+			p = p->mutex_atteso ? p->mutex_atteso->proprietario : nullptr)
+	{
+		if (p == esecuzione) {
+			flog(LOG_WARN, "mutex_lock(%u): stallo", m);
+			c_abort_p();
+			return;
+		}
 	}
+
+	esecuzione->mutex_atteso = mx;
+	esecuzione->attesa = ATT_SINCR;
+	inserimento_lista(mx->pointer, esecuzione);
+	aggiorna_precedenza(mx->proprietario);
+	schedulatore();
 }
 
-/*! @brief Parte C++ della primitiva sem_signal().
- *  @param sem id di semaforo
+/*! @brief Parte C++ della primitiva mutex_unlock().
+ *  @param m	id del mutex
  */
-extern "C" void c_sem_signal(natl sem)
+extern "C" void c_mutex_unlock(natl m)
 {
 	// una primitiva non deve mai fidarsi dei parametri
-	if (!sem_valido(sem)) {
-		flog(LOG_WARN, "semaforo errato: %u", sem);
+	if (!mutex_valido(m)) {
+		flog(LOG_WARN, "mutex errato: %u", m);
 		c_abort_p();
 		return;
 	}
 
-	des_sem* s = &array_dess[sem];
-	s->counter++;
+	des_mutex* mx = &array_desm[m];
+	if (mx->proprietario != esecuzione) {
+		flog(LOG_WARN, "mutex_unlock(%u): mutex non posseduto", m);
+		c_abort_p();
+		return;
+	}
 
-	if (s->counter <= 0) {
-		des_proc* lavoro = rimozione_lista(s->pointer);
+	des_proc* lavoro = cedi_mutex(mx);
+
+	// esecuzione può aver perso la precedenza ereditata. In quel caso
+	// non può essere reinserito in testa a pronti
+	natl prio = precedenza_ereditata(esecuzione);
+	if (prio < esecuzione->precedenza) {
+		esecuzione->precedenza = prio;
+		inserimento_lista(pronti, esecuzione);
+	} else {
 		inspronti();	// preemption
-		inserimento_lista(pronti, lavoro);
-		schedulatore();	// preemption
 	}
+	if (lavoro)
+		inserimento_pronti(lavoro);
+	schedulatore();	// preemption
 }
 /// @}
 
@@ -389,6 +1475,12 @@ struct richiesta {
 /// Coda dei processi sospesi
 richiesta* sospesi;
 
+/// Numero di interruzioni del timer ricevute dall'avvio del sistema
+///
+/// Non è usato dal nucleo: serve al debugger per mostrare il tick in cui
+/// verrà risvegliato ogni processo in @ref sospesi.
+natq orologio;
+
 /*! @brief Inserisce un processo nella coda delle richieste al timer
  *  @param p richiesta da inserire
  */
@@ -427,22 +1519,58 @@ extern "C" void c_delay(natl n)
 	richiesta* p = new richiesta;
 	p->d_attesa = n;
 	p->pp = esecuzione;
+	esecuzione->attesa = ATT_DELAY;
 
 	inserimento_lista_attesa(p);
 	schedulatore();
 }
 
 /// @brief Driver del timer
+///
+/// Se @ref QUANTO è maggiore di zero, un processo che resta in esecuzione per
+/// QUANTO intervalli consecutivi viene inserito in @ref pronti dopo tutti i
+/// processi di pari precedenza, invece che in testa. Il conteggio riparte da
+/// zero ogni volta che il processo lascia il processore (perché si blocca o
+/// perché un processo più prioritario gli subentra). In questo modo i processi
+/// di pari precedenza si alternano in esecuzione (round-robin).
+///
+/// Se il profilo è attivo, registra anche un campione per il processo
+/// interrotto (si veda @ref profilo).
+///
+/// Solo il processore di avvio riceve le interruzioni del timer: il driver
+/// conta i tick anche per i processi in esecuzione sugli altri processori e,
+/// quando uno di questi esaurisce il quanto, chiede al suo processore di
+/// rischedulare (si veda c_driver_cpu()).
 extern "C" void c_driver_td(void)
 {
-	inspronti();
+	campiona();
+	orologio++;
+	esecuzione->tick_cpu++;
+	if (QUANTO && ++esecuzione->tick_quanto >= QUANTO) {
+		esecuzione->tick_quanto = 0;
+		inserimento_lista(pronti, esecuzione);
+	} else {
+		inspronti();
+	}
+
+	for (natl i = 1; i < num_cpu; i++) {
+		des_cpu* c = &cpu[i];
+		des_proc* p = c->esecuzione;
+		if (p == c->inattivo)
+			continue;
+		p->tick_cpu++;
+		if (QUANTO && ++p->tick_quanto >= QUANTO) {
+			c->scaduto = p;
+			richiedi_rischedulazione(c);
+		}
+	}
 
 	if (sospesi != nullptr) {
 		sospesi->d_attesa--;
 	}
 
 	while (sospesi != nullptr && sospesi->d_attesa == 0) {
-		inserimento_lista(pronti, sospesi->pp);
+		inserimento_pronti(sospesi->pp);
 		richiesta* p = sospesi;
 		sospesi = sospesi->p_rich;
 		delete p;
@@ -452,6 +1580,120 @@ extern "C" void c_driver_td(void)
 }
 /// @}
 
+/////////////////////////////////////////////////////////////////////////////////
+/// @defgroup contab		Contabilità del tempo di CPU
+///
+/// La carica_stato chiama contabilita() ogni volta che il nucleo sta per
+/// restituire il controllo a un processo. Il tempo trascorso dalla chiamata
+/// precedente, misurato con il Time Stamp Counter, viene addebitato al
+/// processo che era in esecuzione, compreso il tempo passato nel nucleo per
+/// suo conto (primitive o interruzioni arrivate mentre era in esecuzione).
+///
+/// Se il processo cambia, quello uscente è stato interrotto (involontario)
+/// se si trova in @ref pronti, altrimenti si è bloccato o è terminato
+/// (volontario). Quando il processo tornerà in esecuzione, il tempo
+/// trascorso fuori dal processore verrà addebitato in base al campo
+/// des_proc::attesa, scritto dalle primitive che lo hanno bloccato.
+/// Questo tempo comprende anche quello passato in pronti dopo il risveglio.
+///
+/// Ogni processore addebita il tempo per conto proprio: il processo a cui
+/// lo sta addebitando (nullptr se è terminato) e il valore del TSC
+/// all'ultima chiamata si trovano nel suo descrittore (des_cpu::in_carico e
+/// des_cpu::ultimo_tsc).
+/// @{
+/////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Aggiorna le statistiche dei processi (chiamata da carica_stato)
+extern "C" void contabilita()
+{
+	natq ora = leggi_tsc();
+	des_cpu* c = cpu_corrente();
+	des_proc* p = c->in_carico;
+
+	if (p)
+		p->stat.cpu += ora - c->ultimo_tsc;
+	c->ultimo_tsc = ora;
+
+	if (esecuzione == p)
+		return;
+
+	if (p) {
+		p->tsc_uscita = ora;
+		if (in_lista(pronti, p)) {
+			p->stat.cambi_involontari++;
+			p->attesa = ATT_PRONTO;
+		} else {
+			p->stat.cambi_volontari++;
+		}
+	}
+
+	p = esecuzione;
+	if (p->tsc_uscita) {
+		natq fuori = ora - p->tsc_uscita;
+		switch (p->attesa) {
+		case ATT_PRONTO:
+			p->stat.pronto += fuori;
+			break;
+		case ATT_SINCR:
+			p->stat.sincr += fuori;
+			break;
+		case ATT_DELAY:
+			p->stat.delay += fuori;
+			break;
+		default:
+			p->stat.altro += fuori;
+			break;
+		}
+	}
+	p->attesa = ATT_NESSUNA;
+	// il processo riparte: ha a disposizione un quanto intero
+	p->tick_quanto = 0;
+	natl i = c - cpu;
+	if (p->ultima_cpu != i) {
+		// non contiamo la prima esecuzione
+		if (p->tsc_uscita)
+			p->stat.migrazioni++;
+		p->ultima_cpu = i;
+	}
+	c->in_carico = p;
+}
+
+/*! @brief Parte C++ della primitiva getprocstat().
+ *  @param id	id del processo
+ *  @param ps	struttura da riempire
+ */
+extern "C" void c_getprocstat(natl id, procstat* ps)
+{
+	// una primitiva non deve mai fidarsi dei parametri
+	if (liv_chiamante() == LIV_UTENTE &&
+		!c_access(int_cast<vaddr>(ps), sizeof(*ps), true, false))
+	{
+		flog(LOG_WARN, "getprocstat: parametri non validi: %p", ps);
+		c_abort_p();
+		return;
+	}
+
+	// c_access() ha scritto il proprio risultato in RAX
+	esecuzione->contesto[I_RAX] = false;
+
+	if (id > MAX_PROC_ID)
+		return;
+
+	des_proc* p = des_p(id);
+	if (!p)
+		return;
+
+	*ps = p->stat;
+	// il processo potrebbe essere in esecuzione (qui o su un altro
+	// processore) e non aver ancora ricevuto il tempo dall'ultimo addebito
+	for (natl i = 0; i < num_cpu; i++) {
+		if (cpu[i].in_carico == p)
+			ps->cpu += leggi_tsc() - cpu[i].ultimo_tsc;
+	}
+	esecuzione->contesto[I_RAX] = true;
+}
+/// @}
+
 /////////////////////////////////////////////////////////////////////////////////
 /// @defgroup exc      		Eccezioni
 /// @{
@@ -604,6 +1846,7 @@ paddr alloca_frame()
 	primo_frame_libero = vdf[primo_frame_libero].prossimo_libero;
 	vdf[j].prossimo_libero = 0;
 	num_frame_liberi--;
+	traccia(EV_ALLOCA_FRAME, 0, j * DIM_PAGINA);
 	return j * DIM_PAGINA;
 }
 
@@ -621,6 +1864,7 @@ void rilascia_frame(paddr f)
 	vdf[j].prossimo_libero = primo_frame_libero;
 	primo_frame_libero = j;
 	num_frame_liberi++;
+	traccia(EV_RILASCIA_FRAME, 0, f);
 }
 /// @}
 
@@ -784,6 +2028,341 @@ extern "C" void c_trasforma(vaddr ind_virt)
 }
 /// @}
 
+/////////////////////////////////////////////////////////////////////////////////
+/// @defgroup mbox		Code di messaggi
+///
+/// Una mailbox è una coda circolare di capacità limitata, contenuta nel
+/// modulo sistema. I messaggi vengono copiati dal buffer del mittente alla
+/// coda e poi dalla coda al buffer del destinatario, senza bisogno di
+/// variabili condivise in utente/condivisa.
+///
+/// I messaggi lunghi al più @ref MAX_MSG byte sono copiati direttamente nel
+/// descrittore del messaggio. I messaggi più lunghi (fino a una pagina)
+/// vengono copiati in un frame allocato appositamente. Se il buffer è
+/// un'intera pagina allineata di utente/privata, invece, il frame che la
+/// contiene viene tolto al mittente (che riceve al suo posto un frame
+/// azzerato) e, se anche il buffer del destinatario soddisfa la stessa
+/// condizione, viene installato nella sua memoria virtuale al posto di quello
+/// che c'era prima. In questo caso non viene copiato nessun byte.
+///
+/// Se la coda è piena il mittente si blocca; se è vuota si blocca il
+/// destinatario. Quando un processo bloccato viene risvegliato, la primitiva
+/// viene completata per suo conto usando i parametri salvati nel suo
+/// contesto, accedendo alla sua memoria tramite il suo TRIE.
+/// @{
+/////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Messaggio in una mailbox
+struct des_msg {
+	/// lunghezza in byte
+	natq len;
+	/// frame che contiene il messaggio (0 se il messaggio è in dati)
+	paddr frame;
+	/// contenuto dei messaggi lunghi al più MAX_MSG byte
+	natb dati[MAX_MSG];
+};
+
+/// @brief Descrittore di mailbox
+struct des_mbox {
+	/// numero massimo di messaggi in coda
+	natl dim;
+	/// posizione del messaggio più vecchio in msg
+	natl testa;
+	/// numero di messaggi in coda
+	natl quanti;
+	/// coda circolare dei messaggi (allocata nello heap)
+	des_msg* msg;
+	/// processi bloccati in mbox_send() (coda piena)
+	des_proc* mittenti;
+	/// processi bloccati in mbox_recv() (coda vuota)
+	des_proc* riceventi;
+};
+
+/// Array dei descrittori di mailbox
+des_mbox array_mbox[MAX_MBOX];
+
+/// Numero di mailbox allocate
+natl mbox_allocate = 0;
+
+/*! @brief Copia dalla memoria virtuale di un processo
+ *  @param p	processo
+ *  @param src	indirizzo virtuale (nello spazio di _p_) da cui copiare
+ *  @param dst	destinazione (nel modulo sistema)
+ *  @param n	numero di byte da copiare
+ */
+void copia_da(des_proc* p, vaddr src, natb* dst, natq n)
+{
+	// il buffer può attraversare più pagine, non necessariamente
+	// contigue in memoria fisica
+	while (n > 0) {
+		natq q = DIM_PAGINA - src % DIM_PAGINA;
+		if (q > n)
+			q = n;
+		memcpy(dst, voidptr_cast(trasforma(p->cr3, src)), q);
+		src += q;
+		dst += q;
+		n -= q;
+	}
+}
+
+/*! @brief Copia nella memoria virtuale di un processo
+ *  @param p	processo
+ *  @param dst	indirizzo virtuale (nello spazio di _p_) in cui copiare
+ *  @param src	sorgente (nel modulo sistema)
+ *  @param n	numero di byte da copiare
+ */
+void copia_verso(des_proc* p, vaddr dst, const natb* src, natq n)
+{
+	while (n > 0) {
+		natq q = DIM_PAGINA - dst % DIM_PAGINA;
+		if (q > n)
+			q = n;
+		memcpy(voidptr_cast(trasforma(p->cr3, dst)), src, q);
+		src += q;
+		dst += q;
+		n -= q;
+	}
+}
+
+/*! @brief Controlla se un buffer può essere trasferito per pagina
+ *  @param v	indirizzo del buffer
+ *  @param len	dimensione del buffer
+ *  @return true se il buffer è una pagina allineata di utente/privata
+ */
+bool pagina_privata(vaddr v, natq len)
+{
+	return len == DIM_PAGINA && v % DIM_PAGINA == 0 &&
+		v >= ini_utn_p && v < fin_utn_p;
+}
+
+/*! @brief Sostituisce il frame che contiene una pagina di un processo
+ *  @param p	processo
+ *  @param v	indirizzo virtuale della pagina
+ *  @param f	nuovo frame
+ *  @return	frame sostituito (0 se _v_ non è tradotto da una
+ *  		entrata di livello 1, nel qual caso non viene cambiato niente)
+ */
+paddr scambia_frame(des_proc* p, vaddr v, paddr f)
+{
+	tab_iter it(p->cr3, v);
+	while (it.down())
+		;
+	tab_entry& e = it.get_e();
+	if (it.get_l() != 1 || !(e & BIT_P))
+		return 0;
+
+	paddr vecchio = extr_IND_FISICO(e);
+	set_IND_FISICO(e, f);
+	// le traduzioni degli altri processi vengono comunque
+	// eliminate dal TLB al prossimo caricamento di cr3
+	if (p == esecuzione)
+		invalida_entrata_TLB(v);
+	return vecchio;
+}
+
+/*! @brief Copia (o sposta) un messaggio dal buffer di un processo
+ *  @param p	processo mittente
+ *  @param buf	indirizzo del buffer (nello spazio di _p_)
+ *  @param len	lunghezza del messaggio
+ *  @param m	descrittore da riempire
+ *  @return	false se non c'è memoria sufficiente
+ */
+bool prepara_msg(des_proc* p, vaddr buf, natq len, des_msg& m)
+{
+	m.len = len;
+	m.frame = 0;
+	if (len <= MAX_MSG) {
+		copia_da(p, buf, m.dati, len);
+		return true;
+	}
+
+	paddr f = alloca_frame();
+	if (!f)
+		return false;
+
+	if (pagina_privata(buf, len)) {
+		// il mittente riceve un frame azzerato al posto del suo
+		memset(voidptr_cast(f), 0, DIM_PAGINA);
+		if ( (m.frame = scambia_frame(p, buf, f)) )
+			return true;
+	}
+	copia_da(p, buf, ptr_cast<natb>(f), len);
+	m.frame = f;
+	return true;
+}
+
+/*! @brief Consegna un messaggio a un processo
+ *
+ *  I parametri della mbox_recv() sono letti dal contesto del processo.
+ *
+ *  @param m	messaggio da consegnare
+ *  @param p	processo destinatario
+ */
+void consegna_msg(des_msg& m, des_proc* p)
+{
+	vaddr buf = p->contesto[I_RSI];
+	natq len = p->contesto[I_RDX];
+	if (len > m.len)
+		len = m.len;
+
+	if (!m.frame) {
+		copia_verso(p, buf, m.dati, len);
+	} else {
+		paddr vecchio = 0;
+		if (pagina_privata(buf, len))
+			vecchio = scambia_frame(p, buf, m.frame);
+		if (vecchio) {
+			rilascia_frame(vecchio);
+		} else {
+			copia_verso(p, buf, ptr_cast<natb>(m.frame), len);
+			rilascia_frame(m.frame);
+		}
+	}
+	p->contesto[I_RAX] = len;
+}
+
+/*! @brief Verifica un id di mailbox
+ *  @param mb	id da verificare
+ *  @return	true se _mb_ è l'id di una mailbox allocata
+ */
+bool mbox_valida(natl mb)
+{
+	return mb < mbox_allocate;
+}
+
+/*! @brief Parte C++ della primitiva mbox_ini().
+ *  @param dim	numero massimo di messaggi in coda
+ */
+extern "C" void c_mbox_ini(natl dim)
+{
+	esecuzione->contesto[I_RAX] = 0xFFFFFFFF;
+
+	// una primitiva non deve mai fidarsi dei parametri
+	if (dim == 0 || dim > MAX_MBOX_DIM) {
+		flog(LOG_WARN, "mbox_ini: dimensione non valida: %u", dim);
+		c_abort_p();
+		return;
+	}
+
+	if (mbox_allocate >= MAX_MBOX)
+		return;
+
+	des_msg* msg = new des_msg[dim];
+	if (!msg)
+		return;
+
+	des_mbox* b = &array_mbox[mbox_allocate];
+	b->dim = dim;
+	b->testa = 0;
+	b->quanti = 0;
+	b->msg = msg;
+	b->mittenti = nullptr;
+	b->riceventi = nullptr;
+
+	esecuzione->contesto[I_RAX] = mbox_allocate++;
+}
+
+/*! @brief Parte C++ della primitiva mbox_send().
+ *  @param mb	id della mailbox
+ *  @param buf	messaggio da inviare
+ *  @param len	lunghezza del messaggio
+ */
+extern "C" void c_mbox_send(natl mb, vaddr buf, natq len)
+{
+	// una primitiva non deve mai fidarsi dei parametri
+	if (!mbox_valida(mb)) {
+		flog(LOG_WARN, "mailbox errata: %u", mb);
+		c_abort_p();
+		return;
+	}
+
+	if (len > DIM_PAGINA || (liv_chiamante() == LIV_UTENTE &&
+				!c_access(buf, len, false, false)))
+	{
+		flog(LOG_WARN, "mbox_send: parametri non validi: %lx, %lu", buf, len);
+		c_abort_p();
+		return;
+	}
+
+	des_mbox* b = &array_mbox[mb];
+	if (b->quanti == b->dim) {
+		// il messaggio verrà prelevato da mbox_recv()
+		esecuzione->attesa = ATT_SINCR;
+		inserimento_lista(b->mittenti, esecuzione);
+		schedulatore();
+		return;
+	}
+
+	des_msg m;
+	if (!prepara_msg(esecuzione, buf, len, m)) {
+		esecuzione->contesto[I_RAX] = false;
+		return;
+	}
+	esecuzione->contesto[I_RAX] = true;
+
+	if (b->riceventi) {
+		// la coda è vuota: consegniamo direttamente
+		des_proc* lavoro = rimozione_lista(b->riceventi);
+		consegna_msg(m, lavoro);
+		inspronti();	// preemption
+		inserimento_pronti(lavoro);
+		schedulatore();	// preemption
+		return;
+	}
+
+	b->msg[(b->testa + b->quanti) % b->dim] = m;
+	b->quanti++;
+}
+
+/*! @brief Parte C++ della primitiva mbox_recv().
+ *  @param mb	id della mailbox
+ *  @param buf	buffer in cui ricevere il messaggio
+ *  @param len	dimensione del buffer
+ */
+extern "C" void c_mbox_recv(natl mb, vaddr buf, natq len)
+{
+	// una primitiva non deve mai fidarsi dei parametri
+	if (!mbox_valida(mb)) {
+		flog(LOG_WARN, "mailbox errata: %u", mb);
+		c_abort_p();
+		return;
+	}
+
+	if (liv_chiamante() == LIV_UTENTE && !c_access(buf, len, true, false)) {
+		flog(LOG_WARN, "mbox_recv: parametri non validi: %lx, %lu", buf, len);
+		c_abort_p();
+		return;
+	}
+
+	des_mbox* b = &array_mbox[mb];
+	if (!b->quanti) {
+		// consegna_msg() verrà chiamata da mbox_send()
+		esecuzione->attesa = ATT_SINCR;
+		inserimento_lista(b->riceventi, esecuzione);
+		schedulatore();
+		return;
+	}
+
+	consegna_msg(b->msg[b->testa], esecuzione);
+	b->testa = (b->testa + 1) % b->dim;
+	b->quanti--;
+
+	if (b->mittenti) {
+		// si è liberato un posto: completiamo la mbox_send()
+		// del primo mittente in coda
+		des_proc* lavoro = rimozione_lista(b->mittenti);
+		des_msg& m = b->msg[(b->testa + b->quanti) % b->dim];
+		lavoro->contesto[I_RAX] = prepara_msg(lavoro,
+				lavoro->contesto[I_RSI], lavoro->contesto[I_RDX], m);
+		if (lavoro->contesto[I_RAX])
+			b->quanti++;
+		inspronti();	// preemption
+		inserimento_pronti(lavoro);
+		schedulatore();	// preemption
+	}
+}
+/// @}
+
 /////////////////////////////////////////////////////////////////////////////////
 /// @addtogroup proc
 /// @{
@@ -940,7 +2519,10 @@ des_proc* crea_processo(void f(natq), natq a, int prio, char liv)
 
 	// rimpiamo i campi di cui conosciamo già i valori
 	p->precedenza = prio;
+	p->precedenza_base = prio;
 	p->puntatore = nullptr;
+	p->cpu_preferita = CPU_QUALSIASI;
+	p->ultima_cpu = CPU_QUALSIASI;
 	// il registro RDI deve contenere il parametro da passare alla
 	// funzione f
 	p->contesto[I_RDI] = a;
@@ -1064,6 +2646,10 @@ void distruggi_processo(des_proc* p)
 		distruggi_pila_precedente();
 	}
 	rilascia_proc_id(p->id);
+	for (natl i = 0; i < num_cpu; i++) {
+		if (cpu[i].in_carico == p)
+			cpu[i].in_carico = nullptr;
+	}
 	delete p;
 }
 
@@ -1143,15 +2729,16 @@ extern "C" void distruggi_pila_precedente() {
  *  @param a	parametro per il corpo del processo
  *  @param prio	priorità del processo
  *  @param liv	livello del processo (LIV_UTENTE o LIV_SISTEMA)
+ *  @param cpu	processore preferito (si veda @ref smp)
  */
-extern "C" void c_activate_p(void f(natq), natq a, natl prio, natl liv)
+extern "C" void c_activate_p(void f(natq), natq a, natl prio, natl liv, natl cpu)
 {
 	des_proc* p;			// des_proc per il nuovo processo
 	natl id = 0xFFFFFFFF;		// id da restituire in caso di fallimento
 
 	// non possiamo accettare una priorità minore di quella di dummy
 	// o maggiore di quella del processo chiamante
-	if (prio < MIN_PRIORITY || prio > esecuzione->precedenza) {
+	if (prio < MIN_PRIORITY || prio > esecuzione->precedenza_base) {
 		flog(LOG_WARN, "priorita' non valida: %u", prio);
 		c_abort_p();
 		return;
@@ -1178,7 +2765,11 @@ extern "C" void c_activate_p(void f(natq), natq a, natl prio, natl liv)
 	p = crea_processo(f, a, prio, liv);
 
 	if (p != nullptr) {
-		inserimento_lista(pronti, p);
+		// il processore preferito è solo un suggerimento: se non
+		// esiste lo ignoriamo
+		if (cpu < num_cpu)
+			p->cpu_preferita = cpu;
+		inserimento_pronti(p);
 		processi++;
 		id = p->id;			// id del processo creato
 						// (allocato da crea_processo)
@@ -1196,6 +2787,7 @@ extern "C" void c_terminate_p(bool logmsg)
 
 	if (logmsg)
 		flog(LOG_INFO, "Processo %u terminato", p->id);
+	rilascia_mutex(p);
 	distruggi_processo(p);
 	processi--;
 	schedulatore();
@@ -1381,9 +2973,14 @@ bool crea_spazio_condiviso(paddr root_tab, boot64_modinfo* mod);
 /// @brief Funzione di supporto pr avviare il primo processo (definita in sistema.s)
 extern "C" void salta_a_main();
 
-/// Indirizzo fisico del puntatore alla pila sistema nel segmento TSS.
+/// @brief Indirizzo fisico del puntatore alla pila sistema nel segmento TSS.
+///
+/// Con più processori, cpu_uscita() ci copia quello del processore corrente.
 extern paddr tss_punt_nucleo;
 
+/// @brief Avvia gli altri processori (si veda @ref smp)
+void avvia_ap();
+
 /*! @brief Parte C++ della primitiva fill_gate().
  *  @param tipo		tipo del gate da riempire
  *  @param routine	funzione da associare al gate
@@ -1424,9 +3021,13 @@ extern "C" void main(boot64_info* info)
 	// gli diamo un identificatore, in modo che compaia nei log
 	init.id = 0xFFFF;
 	init.precedenza = MAX_PRIORITY;
+	init.precedenza_base = MAX_PRIORITY;
 	init.cr3 = readCR3();
 	esecuzione = &init;
 	esecuzione_precedente = esecuzione;
+	// nessun processo è ancora uscito dal nucleo (si veda traccia_uscita())
+	for (natl i = 0; i < MAX_CPU; i++)
+		cpu[i].traccia_id = 0xFFFFFFFF;
 
 	flog(LOG_INFO, "Nucleo di Calcolatori Elettronici, v7.1.1");
 
@@ -1484,6 +3085,10 @@ extern "C" void main(boot64_info* info)
 	flog(LOG_INFO, "Inizializzo l'APIC");
 	apic::init(); // in libce
 
+	// gli altri processori restano fermi fino a salta_a_main(), che
+	// rilascia il big kernel lock
+	avvia_ap();
+
 	flog(LOG_INFO, "Cedo il controllo al processo main sistema...");
 	// ora possiamo passare a main_sistema(), che in questo momento è
 	// in testa alla coda pronti.
@@ -1507,6 +3112,18 @@ void (*io_entry)(natq);
 /// @note Inizializzato da crea_spazio_condiviso().
 void (*user_entry)(natq);
 
+/// @brief Punto di aggancio per il debugger
+///
+/// Chiamata da main_sistema() appena il modulo I/O ha terminato la propria
+/// inizializzazione. Non fa niente: serve solo a fornire un simbolo stabile
+/// su cui debug/nucleo.py può mettere un breakpoint (per esempio per
+/// salvare l'istantanea di QEMU, vedi CESNAP in run).
+extern "C" [[gnu::noinline]] void io_pronto()
+{
+	// impedisce al compilatore di eliminare la chiamata
+	asm volatile("");
+}
+
 /// @brief Corpo del processo main_sistema
 void main_sistema(natq)
 {
@@ -1546,6 +3163,7 @@ void main_sistema(natq)
 	}
 	flog(LOG_INFO, "Attendo inizializzazione modulo I/O...");
 	sem_wait(sync_io);
+	io_pronto();
 
 	// creazione del processo main utente
 	flog(LOG_INFO, "Creo il processo main utente");
@@ -1563,6 +3181,330 @@ error:
 	panic("Errore di inizializzazione");
 }
 
+/// @}
+
+///////////////////////////////////////////////////////////////////////////////////
+/// @defgroup smp		Multiprocessore
+///
+/// Se la macchina ha più processori (opzione `-smp` di QEMU), main() avvia
+/// anche gli altri (fino a @ref MAX_CPU in tutto) con la sequenza
+/// INIT-SIPI-SIPI inviata tramite l'APIC locale. I processori secondari
+/// eseguono il codice tra ap_tramp_inizio e ap_tramp_fine (in sistema.s),
+/// copiato in una pagina sotto il primo MiB, e arrivano in main_ap().
+///
+/// Le strutture dati del nucleo sono protette da un unico lock (big kernel
+/// lock), acquisito da salva_stato e rilasciato da carica_stato (si veda
+/// bkl_acquisisci in sistema.s): il resto del nucleo può continuare a
+/// supporre che il codice del modulo sistema venga eseguito da un solo
+/// processore alla volta, a interruzioni disabilitate.
+///
+/// Ogni processore ha la propria coda pronti. Le interruzioni esterne,
+/// compresa quella del timer, arrivano solo al processore di avvio, che
+/// esegue anche tutti i processi di livello sistema; gli altri processori
+/// eseguono i processi utente (si veda primo_idoneo()) e, quando non ne
+/// trovano, il proprio processo inattivo. Un processo che torna pronto va
+/// nella coda del processore preferito, se ne ha uno (si veda
+/// inserimento_pronti()), e lo schedulatore può prenderlo anche dalla coda
+/// di un altro processore. Quando un processore lascia il nucleo,
+/// cpu_uscita() controlla se c'è un processo pronto che un altro processore
+/// dovrebbe eseguire al posto del suo e, in quel caso, gli invia una
+/// interruzione di tipo @ref INTR_TIPO_CPU.
+///
+/// Il debugger mostra lo stato dei processori con il comando `cpu`: per
+/// ognuno il processo in esecuzione, la coda pronti e il numero di
+/// processi presi dalle code degli altri (des_cpu::rubati). Il numero di
+/// volte in cui ogni processo ha cambiato processore si trova in
+/// procstat::migrazioni.
+/// @{
+///////////////////////////////////////////////////////////////////////////////////
+
+/// @name Registri dell'APIC locale
+/// @{
+const natl APIC_ID = 0x20;	///< identificatore
+const natl APIC_TPR = 0x80;	///< priorità delle richieste accettate
+const natl APIC_SVR = 0xF0;	///< abilitazione e tipo delle spurie
+const natl APIC_ICR_LO = 0x300;	///< comando da inviare (parte bassa)
+const natl APIC_ICR_HI = 0x310;	///< destinatario del comando (parte alta)
+/// @}
+
+/// @name Comandi per l'ICR
+/// @{
+const natl ICR_PENDENTE = 1U << 12;	///< invio non ancora completato
+const natl ICR_INIT = 0x000C4500;	///< INIT a tutti tranne se stesso
+const natl ICR_SIPI = 0x000C4600;	///< Startup IPI a tutti tranne se stesso
+/// @}
+
+/// @cond
+// definiti in sistema.s
+extern "C" natb ap_tramp_inizio[], ap_tramp_fine[], ap_tramp_gdt[],
+	ap_tramp_gdtr[], ap_tramp_64[], ap_tramp_salto[],
+	ap_tramp_cr0[], ap_tramp_cr3[], ap_tramp_cr4[], ap_tramp_efer[];
+extern "C" natl bkl, ap_arrivati;
+extern "C" void bkl_acquisisci();
+extern "C" natq leggi_cr0();
+extern "C" natq leggi_cr4();
+extern "C" natq leggi_efer();
+/// @endcond
+
+/// @brief Descrittore della GDT (operando di `lgdt` e `sgdt`)
+struct [[gnu::packed]] gdtr {
+	natw limite;
+	vaddr base;
+};
+
+/// @brief Salva il descrittore della GDT corrente (definita in sistema.s)
+extern "C" void salva_gdtr(gdtr* g);
+
+/// @brief Carica GDT, segmento TSS e IDT sul processore corrente (definita in sistema.s)
+/// @param g	descrittore della GDT
+/// @param sel	selettore del segmento TSS
+extern "C" void ap_carica_cpu(gdtr* g, natw sel);
+
+/// GDT usata dai processori secondari
+gdtr gdtr_smp;
+
+/// Dimensione in byte della GDT del processore di avvio
+natl dim_gdt_avvio;
+
+/*! @brief Invia un comando tramite l'APIC locale
+ *  @param dest		identificatore dell'APIC destinatario
+ *  @param comando	comando da scrivere nella parte bassa dell'ICR
+ */
+void invia_icr(natl dest, natl comando)
+{
+	while (*apic_locale(APIC_ICR_LO) & ICR_PENDENTE)
+		;
+	*apic_locale(APIC_ICR_HI) = dest << 24;
+	*apic_locale(APIC_ICR_LO) = comando;
+}
+
+/// @brief Attende circa _n_ microsecondi (ogni scrittura sulla porta 0x80 ne
+///        richiede circa uno)
+/// @param n	numero di microsecondi
+void attendi_us(natl n)
+{
+	for (natl i = 0; i < n; i++)
+		outputb(0, 0x80);
+}
+
+void richiedi_rischedulazione(des_cpu* c)
+{
+	if (c->ipi)
+		return;
+	c->ipi = true;
+	invia_icr(c->id_apic, INTR_TIPO_CPU);
+}
+
+/// @brief Salva @ref esecuzione nel descrittore del processore (chiamata da carica_stato)
+///
+/// Salva anche @ref pronti, copia in @ref tss_punt_nucleo quello del processore
+/// corrente e chiede di rischedulare agli altri processori che dovrebbero
+/// eseguire un processo pronto al posto del loro (il processo potrà essere
+/// preso dalla coda di un altro processore, si veda schedulatore()).
+extern "C" void cpu_uscita()
+{
+	des_cpu* c = cpu_corrente();
+	c->esecuzione = esecuzione;
+	c->pronti = pronti;
+	if (num_cpu == 1)
+		return;
+	tss_punt_nucleo = c->tss_punt_nucleo;
+	for (natl i = 0; i < num_cpu; i++) {
+		des_cpu* a = &cpu[i];
+		if (a == c)
+			continue;
+		// guardiamo la coda di a e la nostra, in cui possono essere
+		// stati appena inseriti dei processi risvegliati
+		des_proc* p = primo_idoneo(a, a->pronti);
+		des_proc* q = primo_idoneo(a, pronti);
+		if (!p || (q && q->precedenza > p->precedenza))
+			p = q;
+		if (p && (a->esecuzione == a->inattivo ||
+				p->precedenza > a->esecuzione->precedenza))
+			richiedi_rischedulazione(a);
+	}
+}
+
+/// @brief Richiesta di rischedulazione da parte di un altro processore
+///
+/// Il processo in esecuzione torna in @ref pronti: in testa, a meno che non
+/// abbia esaurito il quanto (si veda c_driver_td()).
+extern "C" void c_driver_cpu()
+{
+	des_cpu* c = cpu_corrente();
+	c->ipi = false;
+	if (c->scaduto == esecuzione) {
+		esecuzione->tick_quanto = 0;
+		inserimento_lista(pronti, esecuzione);
+	} else {
+		inspronti();
+	}
+	c->scaduto = nullptr;
+	schedulatore();
+}
+
+/// @brief Corpo dei processi inattivi dei processori secondari
+void inattivo(natq)
+{
+	for (;;)
+		halt();
+}
+
+/*! @brief Registra il processore secondario (chiamata da ap_avvio, senza lock)
+ *  @param i	indice del processore in @ref cpu
+ */
+extern "C" void ap_registra(natl i)
+{
+	des_cpu* c = &cpu[i];
+	c->id_apic = *apic_locale(APIC_ID) >> 24;
+	cpu_apic[c->id_apic] = c;
+}
+
+/*! @brief Completa l'inizializzazione di un processore secondario
+ *
+ *  Chiamata da ap_avvio dopo aver acquisito il big kernel lock. Sceglie
+ *  anche il primo processo da eseguire.
+ *
+ *  @param i	indice del processore in @ref cpu
+ */
+extern "C" void main_ap(natl i)
+{
+	des_cpu* c = &cpu[i];
+
+	ap_carica_cpu(&gdtr_smp, dim_gdt_avvio + (i - 1) * 16);
+	// abilitiamo l'APIC locale e accettiamo tutte le richieste
+	*apic_locale(APIC_SVR) = 0x100 | INTR_TIPO_SPURIO;
+	*apic_locale(APIC_TPR) = 0;
+	flog(LOG_INFO, "Processore %u (APIC %u) attivo", i, c->id_apic);
+
+	esecuzione = c->inattivo;
+	esecuzione_precedente = esecuzione;
+	schedulatore();
+	// da ora in poi possiamo ricevere richieste di rischedulazione
+	c->ipi = false;
+}
+
+/*! @brief Riempie il descrittore del segmento TSS di un processore secondario
+ *  @param d	descrittore (16 byte) nella GDT
+ *  @param c	descrittore del processore
+ */
+void riempi_tss(natq* d, des_cpu* c)
+{
+	natq base = int_cast<natq>(c->tss);
+	natq limite = sizeof(c->tss) - 1;
+
+	// nessuna bitmap di I/O
+	c->tss[25] = sizeof(c->tss) << 16;
+	// il campo RSP0 si trova all'offset 4
+	c->tss_punt_nucleo = int_cast<paddr>(&c->tss[1]);
+
+	d[0] = (limite & 0xFFFF) | ((base & 0xFFFFFF) << 16) |
+		(0x89UL << 40) |	// P=1, DPL=0, TSS a 64 bit disponibile
+		(((limite >> 16) & 0xF) << 48) | (((base >> 24) & 0xFF) << 56);
+	d[1] = base >> 32;
+}
+
+void avvia_ap()
+{
+	des_cpu* c0 = &cpu[0];
+	c0->id_apic = *apic_locale(APIC_ID) >> 24;
+	c0->esecuzione = esecuzione;
+	c0->pronti = pronti;
+	c0->tss_punt_nucleo = tss_punt_nucleo;
+	cpu_apic[c0->id_apic] = c0;
+
+	if (MAX_CPU == 1)
+		return;
+
+	// prepariamo il codice di avvio in una pagina sotto il primo MiB
+	// (lo heap corrente si trova tutto nei primi 640KiB)
+	natq dim = ap_tramp_fine - ap_tramp_inizio;
+	natb* t = static_cast<natb*>(alloc_aligned(DIM_PAGINA, std::align_val_t(DIM_PAGINA)));
+	paddr cr3 = readCR3();
+	if (!t || cr3 >= 4UL*1024*MiB) {
+		flog(LOG_WARN, "Impossibile avviare gli altri processori");
+		dealloc(t);
+		return;
+	}
+	memcpy(t, ap_tramp_inizio, dim);
+	paddr pt = int_cast<paddr>(t);
+	natl* campo;
+	campo = ptr_cast<natl>(t + (ap_tramp_gdtr - ap_tramp_inizio) + 2);
+	*campo = pt + (ap_tramp_gdt - ap_tramp_inizio);
+	campo = ptr_cast<natl>(t + (ap_tramp_salto - ap_tramp_inizio));
+	*campo = pt + (ap_tramp_64 - ap_tramp_inizio);
+	*ptr_cast<natl>(t + (ap_tramp_cr0 - ap_tramp_inizio)) = leggi_cr0();
+	*ptr_cast<natl>(t + (ap_tramp_cr3 - ap_tramp_inizio)) = cr3;
+	// PCIDE non può essere settato fuori dal modo a 64 bit
+	*ptr_cast<natl>(t + (ap_tramp_cr4 - ap_tramp_inizio)) = leggi_cr4() & ~(1U << 17);
+	// LMA verrà settato dal processore
+	*ptr_cast<natl>(t + (ap_tramp_efer - ap_tramp_inizio)) = leggi_efer() & ~(1U << 10);
+
+	// la GDT dei processori secondari è una copia di quella del processore
+	// di avvio, con in più i descrittori dei loro segmenti TSS
+	gdtr g;
+	salva_gdtr(&g);
+	dim_gdt_avvio = g.limite + 1;
+	natq dim_gdt = dim_gdt_avvio + (MAX_CPU - 1) * 16;
+	natb* gdt = static_cast<natb*>(alloc(dim_gdt));
+	if (!gdt) {
+		flog(LOG_WARN, "Impossibile avviare gli altri processori");
+		dealloc(t);
+		return;
+	}
+	memset(gdt, 0, dim_gdt);
+	memcpy(gdt, voidptr_cast(g.base), dim_gdt_avvio);
+	gdtr_smp.limite = dim_gdt - 1;
+	gdtr_smp.base = int_cast<vaddr>(gdt);
+
+	// finché non arrivano in main_ap() non mandiamo richieste ai processori
+	// secondari, né contiamo i tick dei loro processi
+	for (natl i = 1; i < MAX_CPU; i++)
+		cpu[i].ipi = true;
+
+	// da ora in poi i processori secondari che si sono registrati devono
+	// aspettare che il nucleo venga rilasciato da salta_a_main()
+	num_cpu = MAX_CPU;
+	bkl_acquisisci();
+
+	flog(LOG_INFO, "Avvio gli altri processori");
+	invia_icr(0, ICR_INIT);
+	attendi_us(10000);
+	for (int k = 0; k < 2; k++) {
+		invia_icr(0, ICR_SIPI | (pt >> 12));
+		attendi_us(200);
+	}
+	for (natl us = 0; us < 20000 &&
+			__atomic_load_n(&ap_arrivati, __ATOMIC_ACQUIRE) < MAX_CPU - 1; us++)
+		attendi_us(1);
+	// i ritardatari troveranno ap_arrivati >= MAX_CPU - 1 e si fermeranno
+	natl n = __atomic_exchange_n(&ap_arrivati, MAX_CPU, __ATOMIC_ACQ_REL);
+	if (n > MAX_CPU - 1)
+		n = MAX_CPU - 1;
+	// la pagina con il codice di avvio non va deallocata: un ritardatario
+	// potrebbe ancora eseguirlo
+
+	if (!n) {
+		num_cpu = 1;
+		bkl = 0;
+		dealloc(gdt);
+		return;
+	}
+
+	num_cpu = n + 1;
+	for (natl i = 1; i < num_cpu; i++) {
+		des_cpu* c = &cpu[i];
+		des_proc* p = crea_processo(inattivo, i, DUMMY_PRIORITY, LIV_SISTEMA);
+		if (!p)
+			fpanic("Impossibile creare il processo inattivo del processore %u", i);
+		c->inattivo = p;
+		c->esecuzione = p;
+		riempi_tss(ptr_cast<natq>(gdt + dim_gdt_avvio + (i - 1) * 16), c);
+	}
+	flog(LOG_INFO, "Processori: %u", num_cpu);
+}
+/// @}
+
 ///////////////////////////////////////////////////////////////////////////////////
 /// @defgroup mod	Caricamento dei moduli I/O e utente
 ///
@@ -1767,6 +3709,252 @@ vaddr utn_eh_frame;
 natq  utn_eh_frame_len;
 /// @endcond
 
+/// @name Indice delle sezioni .eh_frame
+///
+/// Per trovare la FDE (Frame Description Entry) che descrive la funzione a
+/// cui appartiene un indirizzo, cfi_backstep() scorre la sezione .eh_frame
+/// che le viene passata. Per non scorrere ad ogni passo del backtrace
+/// l'intera sezione del modulo, crea_spazio_condiviso() costruisce per ogni
+/// modulo un indice delle FDE ordinato per indirizzo (come la sezione
+/// .eh_frame_hdr prodotta dal collegatore), in cui backtrace_passo() cerca
+/// per bisezione. A cfi_backstep() viene poi passata solo una copia della FDE
+/// trovata, preceduta dalla sua CIE (si veda copia_cfi()).
+/// @{
+
+/// @brief Elemento dell'indice delle FDE
+struct voce_fde {
+	/// primo indirizzo descritto dalla FDE
+	vaddr inizio;
+	/// primo indirizzo successivo a quelli descritti dalla FDE
+	vaddr fine;
+	/// indirizzo della CIE (Common Information Entry) a cui fa riferimento la FDE
+	vaddr cie;
+	/// indirizzo della FDE
+	vaddr fde;
+	/// lunghezza della FDE (compreso il campo lunghezza)
+	natq len;
+	/// true se la funzione inizia con il prologo che salva il frame
+	/// pointer (`push %rbp; mov %rsp, %rbp`)
+	bool fp;
+};
+
+/// @brief Indice delle FDE di un modulo
+struct indice_fde {
+	/// elementi, ordinati per indirizzo
+	voce_fde* v;
+	/// numero di elementi
+	natq n;
+};
+
+/// @cond
+indice_fde sis_indice_fde;
+indice_fde mio_indice_fde;
+indice_fde utn_indice_fde;
+/// @endcond
+
+/*! @brief Legge un intero in formato ULEB128 e fa avanzare il puntatore
+ *  @param p	puntatore all'intero
+ *  @return	valore letto
+ */
+natq leggi_uleb(natb*& p)
+{
+	natq v = 0;
+	int s = 0;
+	natb b;
+	do {
+		b = *p++;
+		v |= natq(b & 0x7f) << s;
+		s += 7;
+	} while (b & 0x80);
+	return v;
+}
+
+/*! @brief Legge un intero in formato SLEB128 e fa avanzare il puntatore
+ *  @param p	puntatore all'intero
+ *  @return	valore letto
+ */
+long leggi_sleb(natb*& p)
+{
+	natq v = 0;
+	int s = 0;
+	natb b;
+	do {
+		b = *p++;
+		v |= natq(b & 0x7f) << s;
+		s += 7;
+	} while (b & 0x80);
+	if (s < 64 && (b & 0x40))
+		v |= ~0UL << s;
+	return static_cast<long>(v);
+}
+
+/*! @brief Legge un puntatore codificato (DW_EH_PE_*) e fa avanzare il puntatore
+ *  @param p	puntatore al campo da leggere
+ *  @param enc	codifica (sono supportati solo i formati usati da gcc e le
+ *  		applicazioni assoluta e relativa al campo)
+ *  @return	valore letto
+ */
+natq leggi_ptr(natb*& p, natb enc)
+{
+	natb* campo = p;
+	natq v;
+
+	switch (enc & 0x0f) {
+	case 0x00: v = *ptr_cast<natq>(p);		p += 8; break;
+	case 0x01: v = leggi_uleb(p);				break;
+	case 0x02: v = *ptr_cast<natw>(p);		p += 2; break;
+	case 0x03: v = *ptr_cast<natl>(p);		p += 4; break;
+	case 0x04: v = *ptr_cast<natq>(p);		p += 8; break;
+	case 0x09: v = leggi_sleb(p);				break;
+	case 0x0a: v = *ptr_cast<short>(p);		p += 2; break;
+	case 0x0b: v = *ptr_cast<int>(p);		p += 4; break;
+	case 0x0c: v = *ptr_cast<natq>(p);		p += 8; break;
+	default:   return 0;
+	}
+	if ((enc & 0x70) == 0x10)
+		v += int_cast<natq>(campo);
+	return v;
+}
+
+/*! @brief Trova la codifica dei puntatori delle FDE associate a una CIE
+ *  @param cie	indirizzo della CIE
+ *  @return	indirizzo del byte che contiene la codifica (DW_EH_PE_*), o
+ *  		nullptr se la CIE non la specifica (puntatori assoluti)
+ */
+natb* campo_codifica_fde(natb* cie)
+{
+	natb* p = cie + 8;		// salta lunghezza e id
+	natb versione = *p++;
+	const char* aug = ptr_cast<const char>(p);
+	while (*p++)
+		;
+	leggi_uleb(p);			// code alignment factor
+	leggi_sleb(p);			// data alignment factor
+	if (versione == 1)		// registro con l'indirizzo di ritorno
+		p++;
+	else
+		leggi_uleb(p);
+	if (aug[0] != 'z')
+		return nullptr;
+	leggi_uleb(p);			// lunghezza dei dati aggiuntivi
+	for (const char* a = aug + 1; *a; a++) {
+		switch (*a) {
+		case 'R':
+			return p;
+		case 'P': {
+			natb enc = *p++;
+			leggi_ptr(p, enc);
+			break;
+		}
+		case 'L':
+			p++;
+			break;
+		default:
+			return nullptr;
+		}
+	}
+	return nullptr;
+}
+
+/*! @brief Restituisce la codifica dei puntatori delle FDE associate a una CIE
+ *  @param cie	indirizzo della CIE
+ *  @return	codifica (DW_EH_PE_*)
+ */
+natb codifica_fde(natb* cie)
+{
+	natb* c = campo_codifica_fde(cie);
+	return c ? *c : 0;
+}
+
+/*! @brief Costruisce l'indice delle FDE di una sezione .eh_frame
+ *  @param eh_frame	indirizzo della sezione
+ *  @param len		lunghezza della sezione
+ *  @param ind		indice da costruire (vuoto in caso di errore)
+ */
+void indicizza_eh_frame(vaddr eh_frame, natq len, indice_fde& ind)
+{
+	ind.v = nullptr;
+	ind.n = 0;
+
+	// primo passaggio: contiamo le FDE; secondo: riempiamo l'indice
+	for (int passo = 0; passo < 2; passo++) {
+		natq n = 0;
+		natb* p = ptr_cast<natb>(eh_frame);
+		natb* fine = p + len;
+		while (p + 8 <= fine) {
+			natb* e = p;
+			natl l = *ptr_cast<natl>(p);
+			// terminatore, oppure formato a 64 bit (non usato da gcc)
+			if (l == 0 || l == 0xFFFFFFFF)
+				break;
+			p += 4;
+			natb* succ = p + l;
+			natl id = *ptr_cast<natl>(p);
+			if (id != 0) {
+				natb* cie = p - id;
+				natb enc = codifica_fde(cie);
+				natb* q = p + 4;
+				vaddr ini = leggi_ptr(q, enc);
+				natq dim = leggi_ptr(q, enc & 0x0f);
+				// le FDE di funzioni scartate dal collegatore
+				// hanno dimensione nulla
+				if (dim) {
+					if (passo) {
+						natb* c = ptr_cast<natb>(ini);
+						bool fp = dim >= 4 && c[0] == 0x55 &&
+							c[1] == 0x48 && c[2] == 0x89 && c[3] == 0xe5;
+						ind.v[n] = { ini, ini + dim, int_cast<vaddr>(cie),
+							int_cast<vaddr>(e), natq(succ - e), fp };
+					}
+					n++;
+				}
+			}
+			p = succ;
+		}
+		if (!passo) {
+			if (!n)
+				return;
+			ind.v = new voce_fde[n];
+			if (!ind.v) {
+				flog(LOG_WARN, "memoria insufficiente per l'indice di .eh_frame");
+				return;
+			}
+		} else {
+			ind.n = n;
+		}
+	}
+
+	// ordinamento per inserimento (le FDE sono già quasi ordinate)
+	for (natq i = 1; i < ind.n; i++) {
+		voce_fde v = ind.v[i];
+		natq j = i;
+		for ( ; j > 0 && ind.v[j - 1].inizio > v.inizio; j--)
+			ind.v[j] = ind.v[j - 1];
+		ind.v[j] = v;
+	}
+}
+
+/*! @brief Cerca per bisezione la FDE che descrive un indirizzo
+ *  @param ind	indice in cui cercare
+ *  @param rip	indirizzo da cercare
+ *  @return	elemento dell'indice (nullptr se non trovato)
+ */
+voce_fde* cerca_fde(const indice_fde& ind, vaddr rip)
+{
+	natq a = 0, b = ind.n;
+	while (a < b) {
+		natq m = (a + b) / 2;
+		if (ind.v[m].fine <= rip)
+			a = m + 1;
+		else
+			b = m;
+	}
+	if (a < ind.n && ind.v[a].inizio <= rip)
+		return &ind.v[a];
+	return nullptr;
+}
+/// @}
+
 /// @cond
 bool crea_spazio_condiviso(paddr root_tab, boot64_modinfo* mod)
 {
@@ -1781,6 +3969,9 @@ bool crea_spazio_condiviso(paddr root_tab, boot64_modinfo* mod)
 	find_eh_frame(mod[0].mod_start, sis_eh_frame, sis_eh_frame_len);
 	find_eh_frame(mod[1].mod_start, mio_eh_frame, mio_eh_frame_len);
 	find_eh_frame(mod[2].mod_start, utn_eh_frame, utn_eh_frame_len);
+	indicizza_eh_frame(sis_eh_frame, sis_eh_frame_len, sis_indice_fde);
+	indicizza_eh_frame(mio_eh_frame, mio_eh_frame_len, mio_indice_fde);
+	indicizza_eh_frame(utn_eh_frame, utn_eh_frame_len, utn_indice_fde);
 
 	return true;
 }
@@ -1802,6 +3993,7 @@ extern "C" void panic(const char* msg)
 
 	if (in_panic) {
 		flog(LOG_ERR, "panic ricorsivo. STOP");
+		blog_svuota();
 		end_program();
 	}
 	in_panic = 1;
@@ -1819,6 +4011,7 @@ extern "C" void panic(const char* msg)
 				process_dump(proc_table[id], LOG_ERR);
 		}
 	}
+	blog_svuota();
 	end_program();
 }
 
@@ -1871,6 +4064,26 @@ extern "C" void c_do_log(log_sev sev, const char* buf, natl quanti)
 	do_log(sev, buf, quanti);
 }
 
+/*! @brief Parte C++ della primitiva blog().
+ *
+ *  La primitiva è riservata al modulo I/O (il nucleo chiama direttamente
+ *  blog()), quindi non è necessario controllare i puntatori.
+ *
+ *  @param sev	severità del messaggio
+ *  @param fmt	indirizzo del formato
+ *  @param n	numero di argomenti
+ *  @param args	argomenti
+ */
+extern "C" void c_blog(log_sev sev, const char* fmt, natl n, const natq* args)
+{
+	if (sev > MAX_LOG || n > MAX_BLOG_ARGS) {
+		flog(LOG_WARN, "blog: parametri non validi");
+		c_abort_p();
+		return;
+	}
+	blog(sev, fmt, n, args);
+}
+
 /// @brief Parte C++ della primitiva getmeminfo().
 extern "C" void c_getmeminfo()
 {
@@ -1910,16 +4123,14 @@ natq read_mem(void* token, vaddr v)
 	return rv;
 }
 
-/*! @brief Invia sul log il backtrace di un processo.
+/*! @brief Prepara lo srotolamento della pila di un processo.
  *
+ *  @param cfi	stato dello srotolamento (inizializzato dalla funzione)
  *  @param p	descrittore del processo
- *  @param sev	severità dei messaggi da inviare al log
- *  @param msg	primo messaggio da inviare (intestazione)
+ *  @return	indirizzo a cui è stato interrotto il processo
  */
-void backtrace(des_proc* p, log_sev sev, const char* msg)
+vaddr backtrace_ini(cfi_d& cfi, des_proc* p)
 {
-	cfi_d cfi;
-
 	cfi.regs[CFI::RAX] = p->contesto[I_RAX];
 	cfi.regs[CFI::RCX] = p->contesto[I_RCX];
 	cfi.regs[CFI::RDX] = p->contesto[I_RDX];
@@ -1940,37 +4151,172 @@ void backtrace(des_proc* p, log_sev sev, const char* msg)
 	cfi.token = p;
 	cfi.read_stack = read_mem;
 
-	vaddr rip = read_mem(p, p->contesto[I_RSP]) - 1;
-	do {
-		if (rip >= ini_sis_c && rip < fin_sis_c) {
-			cfi.eh_frame = sis_eh_frame;
-			cfi.eh_frame_len = sis_eh_frame_len;
-		} else if (rip >= ini_mio_c && rip < fin_mio_c) {
-			cfi.eh_frame = mio_eh_frame;
-			cfi.eh_frame_len = mio_eh_frame_len;
-		} else if (rip >= ini_utn_c && rip < fin_utn_c) {
-			cfi.eh_frame = utn_eh_frame;
-			cfi.eh_frame_len = utn_eh_frame_len;
-		} else {
-			cfi.eh_frame = 0;
-			cfi.eh_frame_len = 0;
-		}
+	return read_mem(p, p->contesto[I_RSP]);
+}
 
-		if (!cfi.eh_frame)
-			break;
+/*! @brief Controlla che un indirizzo appartenga a una delle pile di un processo
+ *  @param v	indirizzo da controllare
+ *  @return	true se _v_ si trova nella pila sistema o nella pila utente
+ */
+bool in_pila(vaddr v)
+{
+	return (v >= fin_sis_p - DIM_SYS_STACK && v < fin_sis_p) ||
+		(v >= fin_utn_p - DIM_USR_STACK && v < fin_utn_p);
+}
+
+/*! @brief Esegue un passo dello srotolamento usando il frame pointer.
+ *
+ *  Va usata solo per funzioni che hanno salvato il frame pointer (si veda
+ *  voce_fde::fp) e che non si trovano nel prologo, cioè non per la
+ *  funzione interrotta.
+ *
+ *  @param cfi	stato dello srotolamento
+ *  @return	false se il frame pointer non punta nella pila del processo
+ */
+bool passo_fp(cfi_d& cfi)
+{
+	vaddr rbp = cfi.regs[CFI::RBP];
+
+	if (rbp % sizeof(natq) || rbp < cfi.regs[CFI::RSP] ||
+			!in_pila(rbp) || !in_pila(rbp + 2 * sizeof(natq) - 1))
+		return false;
+
+	cfi.regs[CFI::RA]  = cfi.read_stack(cfi.token, rbp + sizeof(natq));
+	cfi.regs[CFI::RBP] = cfi.read_stack(cfi.token, rbp);
+	cfi.regs[CFI::RSP] = rbp + 2 * sizeof(natq);
+	return true;
+}
+
+/// Dimensione massima della copia di CIE e FDE passata a cfi_backstep()
+const natq DIM_COPIA_CFI = 512;
 
+/*! @brief Copia una FDE, preceduta dalla sua CIE, in un buffer
+ *
+ *  cfi_backstep() deve trovare la CIE nella sezione che le viene passata,
+ *  prima della FDE. Nella sezione .eh_frame, però, tra la CIE e la FDE si
+ *  trovano di solito le FDE di tutte le altre funzioni dello stesso file
+ *  oggetto. Costruiamo quindi una piccola sezione che contiene solo la CIE,
+ *  la FDE e il terminatore. Poiché nella copia i campi si spostano, i
+ *  puntatori della FDE (relativi alla loro posizione, nel codice prodotto
+ *  da gcc) vengono riscritti in formato assoluto a 64 bit, e la codifica
+ *  nella copia della CIE viene modificata di conseguenza.
+ *
+ *  @param f	elemento dell'indice
+ *  @param buf	buffer di @ref DIM_COPIA_CFI byte
+ *  @return	numero di byte scritti (0 se la copia non entra nel buffer)
+ */
+natq copia_cfi(const voce_fde& f, natb* buf)
+{
+	natb* cie = ptr_cast<natb>(f.cie);
+	natb* fde = ptr_cast<natb>(f.fde);
+	natq len_cie = *ptr_cast<natl>(cie) + 4;
+	natb* campo = campo_codifica_fde(cie);
+	natb enc = campo ? *campo : 0;
+
+	// saltiamo lunghezza, distanza dalla CIE, indirizzo iniziale e
+	// dimensione: il resto (dati aggiuntivi e istruzioni) si copia così com'è
+	natb* q = fde + 8;
+	leggi_ptr(q, enc);
+	leggi_ptr(q, enc & 0x0f);
+	natq resto = fde + f.len - q;
+	natq dim = len_cie + 8 + 2 * sizeof(natq) + resto + 4;
+	if (dim > DIM_COPIA_CFI)
+		return 0;
+
+	memcpy(buf, cie, len_cie);
+	if (campo)
+		buf[campo - cie] = 0x00;	// DW_EH_PE_absptr
+	natb* d = buf + len_cie;
+	*ptr_cast<natl>(d) = 4 + 2 * sizeof(natq) + resto;
+	*ptr_cast<natl>(d + 4) = d + 4 - buf;
+	*ptr_cast<natq>(d + 8) = f.inizio;
+	*ptr_cast<natq>(d + 16) = f.fine - f.inizio;
+	memcpy(d + 24, q, resto);
+	*ptr_cast<natl>(d + 24 + resto) = 0;
+	return dim;
+}
+
+/*! @brief Esegue un passo dello srotolamento della pila.
+ *
+ *  @param cfi	stato dello srotolamento (preparato da backtrace_ini())
+ *  @param rip	indirizzo di un'istruzione della funzione da srotolare
+ *  @param primo	true se è il primo passo (la funzione interrotta potrebbe
+ *  		trovarsi nel prologo)
+ *  @return	indirizzo dell'istruzione di chiamata nella funzione
+ *  		chiamante (0 se non è possibile proseguire)
+ *
+ *  La FDE che descrive _rip_ viene cercata nell'indice del modulo (si veda
+ *  indicizza_eh_frame()). Se la funzione salva il frame pointer, il passo
+ *  viene eseguito seguendo la catena dei valori salvati di %rbp (tutti i
+ *  moduli sono compilati con -fno-omit-frame-pointer) e cfi_backstep() è
+ *  usata solo per la funzione interrotta, per le funzioni scritte in
+ *  assembler (salva_stato, gli stub delle primitive, gli handler) e se il
+ *  frame pointer non è valido.
+ */
+vaddr backtrace_passo(cfi_d& cfi, vaddr rip, bool primo)
+{
+	const indice_fde* ind;
+	if (rip >= ini_sis_c && rip < fin_sis_c) {
+		cfi.eh_frame = sis_eh_frame;
+		cfi.eh_frame_len = sis_eh_frame_len;
+		ind = &sis_indice_fde;
+	} else if (rip >= ini_mio_c && rip < fin_mio_c) {
+		cfi.eh_frame = mio_eh_frame;
+		cfi.eh_frame_len = mio_eh_frame_len;
+		ind = &mio_indice_fde;
+	} else if (rip >= ini_utn_c && rip < fin_utn_c) {
+		cfi.eh_frame = utn_eh_frame;
+		cfi.eh_frame_len = utn_eh_frame_len;
+		ind = &utn_indice_fde;
+	} else {
+		cfi.eh_frame = 0;
+		cfi.eh_frame_len = 0;
+		ind = nullptr;
+	}
+
+	if (!cfi.eh_frame)
+		return 0;
+
+	// se l'indice non è disponibile scorriamo tutta la sezione
+	if (ind->n) {
+		voce_fde* f = cerca_fde(*ind, rip);
+		if (!f)
+			return 0;
+		if (!primo && f->fp && passo_fp(cfi))
+			goto fatto;
+		// se la copia non entra nel buffer (FDE molto lunghe)
+		// resta l'intera sezione
+		natb buf[DIM_COPIA_CFI];
+		if (natq dim = copia_cfi(*f, buf)) {
+			cfi.eh_frame = int_cast<vaddr>(buf);
+			cfi.eh_frame_len = dim;
+		}
 		if (!cfi_backstep(cfi, rip))
-			break;
+			return 0;
+	} else if (!cfi_backstep(cfi, rip)) {
+		return 0;
+	}
 
-		rip = cfi.regs[CFI::RA];
+fatto:
 
-		if (!rip)
-			break;
+	rip = cfi.regs[CFI::RA];
 
-		rip--;
+	return rip ? rip - 1 : 0;
+}
+
+/*! @brief Invia sul log il backtrace di un processo.
+ *
+ *  @param p	descrittore del processo
+ *  @param sev	severità dei messaggi da inviare al log
+ *  @param msg	primo messaggio da inviare (intestazione)
+ */
+void backtrace(des_proc* p, log_sev sev, const char* msg)
+{
+	cfi_d cfi;
 
+	vaddr rip = backtrace_ini(cfi, p) - 1;
+	for (bool primo = true; (rip = backtrace_passo(cfi, rip, primo)); primo = false)
 		flog(sev, "%s0x%lx", msg, rip);
-	} while (true);
 }
 
 /*! @brief Invia sul log lo stato di un processo
@@ -1982,8 +4328,8 @@ void process_dump(des_proc* p, log_sev sev)
 {
 	natq* pila = ptr_cast<natq>(trasforma(p->cr3, p->contesto[I_RSP]));
 
-	flog(sev, "proc %u: corpo %p(%lu), livello %s, precedenza %u", p->id, p->corpo, p->parametro,
-			p->livello == LIV_UTENTE ? "UTENTE" : "SISTEMA", p->precedenza);
+	flog(sev, "proc %u: corpo %p(%lu), livello %s, precedenza %u, cpu %lu tick", p->id, p->corpo, p->parametro,
+			p->livello == LIV_UTENTE ? "UTENTE" : "SISTEMA", p->precedenza, p->tick_cpu);
 	if (pila) {
 		flog(sev, "  RIP=0x%lx CPL=%s", pila[0], pila[1] == SEL_CODICE_UTENTE ? "LIV_UTENTE" : "LIV_SISTEMA");
 		natq rflags = pila[2];
@@ -2003,6 +4349,14 @@ void process_dump(des_proc* p, log_sev sev)
 	} else {
 		flog(sev, "  impossibile leggere la pila del processo");
 	}
+	flog(sev, "  TSC: cpu=%lu pronto=%lu sincr=%lu delay=%lu altro=%lu cambi=%u+%u",
+			p->stat.cpu,
+			p->stat.pronto,
+			p->stat.sincr,
+			p->stat.delay,
+			p->stat.altro,
+			p->stat.cambi_volontari,
+			p->stat.cambi_involontari);
 	flog(sev, "  RAX=%16lx RBX=%16lx RCX=%16lx RDX=%16lx",
 			p->contesto[I_RAX],
 			p->contesto[I_RBX],
@@ -2030,4 +4384,110 @@ void process_dump(des_proc* p, log_sev sev)
 }
 /// @}
 /// @}
+
+/////////////////////////////////////////////////////////////////////////////////
+/// @defgroup profilo		Profilo a campionamento
+///
+/// Se @ref profilo_attivo è true, ad ogni interruzione del timer
+/// c_driver_td() chiama campiona(), che registra l'indirizzo a cui è stato
+/// interrotto il processo in esecuzione (lo stesso mostrato da
+/// process_dump()), il livello a cui si trovava e, se @ref PROF_PROFONDITA
+/// è maggiore di 1, i primi indirizzi del suo backtrace.
+///
+/// I campioni uguali (stesso processo, livello e indirizzi) occupano un solo
+/// elemento della tabella @ref profilo, che ne conta le occorrenze. La
+/// tabella contiene quindi l'istogramma dei campioni di ogni processo. Se la
+/// tabella è piena, i nuovi campioni vengono solo contati in @ref
+/// profilo_persi.
+///
+/// Il timer interrompe solo codice eseguito a interruzioni abilitate
+/// (livello utente, modulo I/O e processo dummy): il tempo passato nel
+/// nucleo non compare nel profilo. Inoltre il timer interrompe solo il
+/// processore di avvio (si veda @ref smp): i processi in esecuzione sugli
+/// altri processori non vengono campionati.
+///
+/// La tabella si legge dal debugger (comando `profile`), che la può salvare
+/// in un file per util/profile.pl.
+/// @{
+/////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Elemento della tabella del profilo
+struct campione {
+	/// numero di occorrenze (0 se l'elemento è libero)
+	natq conta;
+	/// id del processo
+	natl id;
+	/// livello a cui si trovava il processore (LIV_UTENTE o LIV_SISTEMA)
+	natb liv;
+	/// numero di indirizzi validi in pc
+	natb prof;
+	/// indirizzo interrotto, seguito dagli indirizzi delle istruzioni
+	/// di chiamata, dalla funzione più interna alla più esterna
+	vaddr pc[PROF_PROFONDITA];
+};
+
+/// Tabella hash dei campioni
+campione profilo[DIM_PROFILO];
+
+/// Numero di campioni che non hanno trovato posto nella tabella
+natq profilo_persi;
+
+/// Se true, c_driver_td() registra un campione ad ogni interruzione
+/// (modificabile dal debugger)
+bool profilo_attivo = false;
+
+/// @brief Registra un campione per il processo in esecuzione (se il profilo è attivo)
+///
+/// @warning va chiamata all'inizio di c_driver_td(), prima che @ref
+/// esecuzione possa cambiare
+void campiona()
+{
+	if (!profilo_attivo)
+		return;
+
+	// come in liv_chiamante()
+	natq* pila = ptr_cast<natq>(esecuzione->contesto[I_RSP]);
+	natb liv = pila[1] == SEL_CODICE_SISTEMA ? LIV_SISTEMA : LIV_UTENTE;
+	vaddr pc[PROF_PROFONDITA] = { pila[0] };
+	natl n = 1;
+	if (PROF_PROFONDITA > 1) {
+		cfi_d cfi;
+		// pila[0] non è un indirizzo di ritorno: non va decrementato
+		vaddr rip = backtrace_ini(cfi, esecuzione);
+		while (n < PROF_PROFONDITA && (rip = backtrace_passo(cfi, rip, n == 1)))
+			pc[n++] = rip;
+	}
+
+	// hash FNV-1a del campione
+	natq h = 0xcbf29ce484222325UL;
+	h = (h ^ esecuzione->id) * 0x100000001b3UL;
+	h = (h ^ liv) * 0x100000001b3UL;
+	for (natl i = 0; i < n; i++)
+		h = (h ^ pc[i]) * 0x100000001b3UL;
+
+	for (natq k = 0; k < DIM_PROFILO; k++) {
+		campione* c = &profilo[(h + k) % DIM_PROFILO];
+		if (!c->conta) {
+			c->conta = 1;
+			c->id = esecuzione->id;
+			c->liv = liv;
+			c->prof = n;
+			for (natl i = 0; i < PROF_PROFONDITA; i++)
+				c->pc[i] = pc[i];
+			return;
+		}
+		if (c->id != esecuzione->id || c->liv != liv || c->prof != n)
+			continue;
+		natl i = 0;
+		while (i < n && c->pc[i] == pc[i])
+			i++;
+		if (i == n) {
+			c->conta++;
+			return;
+		}
+	}
+	profilo_persi++;
+}
+/// @}
+
 /// @}
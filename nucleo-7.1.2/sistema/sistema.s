@@ -37,6 +37,88 @@ halt:
 	hlt
 	ret
 
+// legge il registro dei flag
+	.global leggi_rflags
+leggi_rflags:
+	pushfq
+	popq %rax
+	ret
+
+// invoca la primitiva blog(), per i processi del modulo sistema (si veda
+// blog() in sistema.cpp)
+	.global blog_primitiva
+blog_primitiva:
+	.cfi_startproc
+	int $TIPO_BLOG
+	ret
+	.cfi_endproc
+
+// legge il Time Stamp Counter
+	.global leggi_tsc
+leggi_tsc:
+	rdtsc
+	shlq $32, %rdx
+	orq %rdx, %rax
+	ret
+
+//////////////////////////////////////////////////////////////////////////
+// BIG KERNEL LOCK                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+// Con più processori attivi (num_cpu > 1) un solo processore alla volta
+// può eseguire il codice del nucleo. salva_stato acquisisce il lock e
+// carica_stato lo rilascia; nel mezzo le interruzioni sono disabilitate,
+// come nel caso di un solo processore.
+//
+// Il lock contiene 0 se è libero, altrimenti l'identificatore dell'APIC
+// locale del processore che lo possiede, più uno. Se il processore possiede
+// già il lock (per es. perché si è verificata un'eccezione mentre eseguiva
+// il nucleo) non facciamo niente. Al primo ingresso, invece, copiamo in
+// esecuzione e pronti il processo e la coda del processore (salvati da
+// carica_stato tramite cpu_uscita()). Nessun registro viene sporcato.
+
+// offset di esecuzione e pronti all'interno di des_cpu
+.set ESECUZIONE_CPU, 0
+.set PRONTI_CPU, 8
+// registro ID dell'APIC locale (si veda APIC_LOCALE in sistema.cpp)
+.set APIC_ID, 0xFEE00020
+
+	.global bkl_acquisisci
+bkl_acquisisci:
+	.cfi_startproc
+	cmpl $1, num_cpu
+	je 3f
+	pushq %rax
+	.cfi_adjust_cfa_offset 8
+	pushq %rcx
+	.cfi_adjust_cfa_offset 8
+	pushq %rdx
+	.cfi_adjust_cfa_offset 8
+	movabsl APIC_ID, %eax
+	shrl $24, %eax
+	movl %eax, %edx
+	leal 1(%rax), %ecx
+1:	xorl %eax, %eax
+	lock cmpxchgl %ecx, bkl
+	je 4f			// acquisito
+	cmpl %eax, %ecx
+	je 2f			// era già nostro
+	pause
+	jmp 1b
+4:	movq cpu_apic(,%rdx,8), %rax
+	movq ESECUZIONE_CPU(%rax), %rcx
+	movq %rcx, esecuzione
+	movq PRONTI_CPU(%rax), %rcx
+	movq %rcx, pronti
+2:	popq %rdx
+	.cfi_adjust_cfa_offset -8
+	popq %rcx
+	.cfi_adjust_cfa_offset -8
+	popq %rax
+	.cfi_adjust_cfa_offset -8
+3:	ret
+	.cfi_endproc
+
 //////////////////////////////////////////////////////////////////////////
 // SALVATAGGIO/CARICAMENTO STATO PROCESSI                               //
 //////////////////////////////////////////////////////////////////////////
@@ -77,6 +159,10 @@ salva_stato:
 	.cfi_adjust_cfa_offset 8
 	.cfi_offset rax, -24
 
+	// con più processori, esecuzione diventa valida solo dopo aver
+	// acquisito il lock
+	call bkl_acquisisci
+
 	movq esecuzione, %rbx
 	movq %rbx, esecuzione_precedente
 
@@ -108,6 +194,22 @@ salva_stato:
 	movq %r14, R14(%rbx)
 	movq %r15, R15(%rbx)
 
+	// registriamo l'entrata nella traccia, passando l'indirizzo di
+	// ritorno (che si trova nello stub che ci ha chiamati). La funzione
+	// C può sporcare i registri scratch, che ricarichiamo dal des_proc
+	cmpb $0, traccia_attiva
+	je 1f
+	movq 16(%rsp), %rdi
+	call traccia_entrata
+	movq RCX(%rbx), %rcx
+	movq RDX(%rbx), %rdx
+	movq RSI(%rbx), %rsi
+	movq RDI(%rbx), %rdi
+	movq R8 (%rbx), %r8
+	movq R9 (%rbx), %r9
+	movq R10(%rbx), %r10
+	movq R11(%rbx), %r11
+1:
 	popq %rax
 	.cfi_adjust_cfa_offset -8
 	.cfi_restore rax
@@ -124,6 +226,13 @@ salva_stato:
 carica_stato:
 	.cfi_startproc
 	.cfi_def_cfa_offset 8
+	// addebitiamo il tempo trascorso al processo uscente
+	call contabilita
+	call traccia_uscita
+	// salviamo esecuzione nel des_cpu del processore (che ci dice anche
+	// quale TSS usare) e avvisiamo gli altri processori, se necessario
+	call cpu_uscita
+
 	movq esecuzione, %rbx
 
 	popq %rcx   //ind di ritorno, va messo nella nuova pila
@@ -179,6 +288,10 @@ carica_stato:
 	movq R15(%rbx), %r15
 	movq RBX(%rbx), %rbx
 
+	// abbiamo finito di usare le strutture dati del nucleo: rilasciamo il
+	// big kernel lock (una semplice scrittura è sufficiente, e non
+	// sporca alcun registro)
+	movl $0, bkl
 
 	retq
 	.cfi_endproc
@@ -249,6 +362,14 @@ init_idt:
 	carica_gate	TIPO_D		a_delay		LIV_UTENTE
 	carica_gate	TIPO_L		a_do_log	LIV_UTENTE
 	carica_gate	TIPO_GMI	a_getmeminfo	LIV_UTENTE
+	carica_gate	TIPO_SF		a_sem_fini	LIV_UTENTE
+	carica_gate	TIPO_SN		a_sem_signal_n	LIV_UTENTE
+	carica_gate	TIPO_SSW	a_sem_signal_wait	LIV_UTENTE
+	carica_gate	TIPO_WA		a_sem_wait_any	LIV_UTENTE
+	carica_gate	TIPO_MI		a_mbox_ini	LIV_UTENTE
+	carica_gate	TIPO_MS		a_mbox_send	LIV_UTENTE
+	carica_gate	TIPO_MR		a_mbox_recv	LIV_UTENTE
+	carica_gate	TIPO_MXI	a_mutex_ini	LIV_UTENTE
 
 	// primitive per il livello I/O (tipi 0x3-)
 	carica_gate	TIPO_APE	a_activate_pe	LIV_SISTEMA
@@ -258,6 +379,12 @@ init_idt:
 	carica_gate	TIPO_IOP	a_io_panic	LIV_SISTEMA
 	carica_gate	TIPO_TRA	a_trasforma	LIV_SISTEMA
 	carica_gate	TIPO_ACC	a_access	LIV_SISTEMA
+	carica_gate	TIPO_BLOG	a_blog		LIV_SISTEMA
+
+	// altre primitive comuni (tipi 0x38-0x3F)
+	carica_gate	TIPO_MXL	a_mutex_lock	LIV_UTENTE
+	carica_gate	TIPO_MXU	a_mutex_unlock	LIV_UTENTE
+	carica_gate	TIPO_GPS	a_getprocstat	LIV_UTENTE
 
 	// i tipi 0x4- verranno usati per le primitive fornite dal modulo I/O
 	// (si veda fill_io_gates() in io.s)
@@ -267,6 +394,9 @@ init_idt:
 
 	// la priorità massima è riservata al driver del timer di sistema
 	carica_gate	INTR_TIPO_TIMER	driver_td	LIV_SISTEMA
+	// richieste di rischedulazione inviate dagli altri processori
+	carica_gate	INTR_TIPO_CPU	driver_cpu	LIV_SISTEMA
+	carica_gate	INTR_TIPO_SPURIO	spurio	LIV_SISTEMA
 
 	// idt_pointer è definito nella libce
 	lidt idt_pointer
@@ -312,6 +442,18 @@ a_sem_ini:
 	iretq
 	.cfi_endproc
 
+	.extern c_sem_fini
+a_sem_fini:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_sem_fini
+	call carica_stato
+	iretq
+	.cfi_endproc
+
 	.extern c_sem_wait
 a_sem_wait:
 	.cfi_startproc
@@ -336,6 +478,126 @@ a_sem_signal:
 	iretq
 	.cfi_endproc
 
+	.extern c_sem_signal_n
+a_sem_signal_n:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_sem_signal_n
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+	.extern c_sem_signal_wait
+a_sem_signal_wait:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_sem_signal_wait
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+	.extern c_sem_wait_any
+a_sem_wait_any:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_sem_wait_any
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+	.extern c_mbox_ini
+a_mbox_ini:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_mbox_ini
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+	.extern c_mbox_send
+a_mbox_send:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_mbox_send
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+	.extern c_mbox_recv
+a_mbox_recv:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_mbox_recv
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+	.extern c_mutex_ini
+a_mutex_ini:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_mutex_ini
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+	.extern c_mutex_lock
+a_mutex_lock:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_mutex_lock
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+	.extern c_mutex_unlock
+a_mutex_unlock:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_mutex_unlock
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+	.extern c_getprocstat
+a_getprocstat:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_getprocstat
+	call carica_stato
+	iretq
+	.cfi_endproc
+
 	.extern c_delay
 a_delay:
 	.cfi_startproc
@@ -459,6 +721,18 @@ a_access:
 	iretq
 	.cfi_endproc
 
+	.extern c_blog
+a_blog:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_blog
+	call carica_stato
+	iretq
+	.cfi_endproc
+
 ////////////////////////////////////////////////////////////////
 // gestori delle eccezioni				      //
 ////////////////////////////////////////////////////////////////
@@ -478,7 +752,9 @@ a_access:
 // exc_error. Il contenuto di exc_error viene poi passato come secondo
 // parametro di gestore_eccezioni.  Le eccezioni che non prevedono questa
 // ulteriore parola quadrupla si limitano a passare 0. L'uso della variabile
-// globale exc_error non causa problemi, perché le interruzioni sono disabilitate.
+// globale exc_error non causa problemi, perché le interruzioni sono disabilitate
+// e, con più processori, perché prima di scriverla acquisiamo il big kernel
+// lock (la successiva chiamata in salva_stato non farà niente).
 //
 exc_div_error:
 	.cfi_startproc
@@ -597,6 +873,7 @@ exc_dbl_fault:
 	.cfi_def_cfa_offset 48
 	.cfi_offset rip, -40
 	.cfi_offset rsp, -16
+	call bkl_acquisisci
 	popq exc_error
 	call salva_stato
 	movq $8, %rdi
@@ -626,6 +903,7 @@ exc_inv_tss:
 	.cfi_def_cfa_offset 48
 	.cfi_offset rip, -40
 	.cfi_offset rsp, -16
+	call bkl_acquisisci
 	pop exc_error
 	.cfi_adjust_cfa_offset -8
 	call salva_stato
@@ -642,6 +920,7 @@ exc_segm_fault:
 	.cfi_def_cfa_offset 48
 	.cfi_offset rip, -40
 	.cfi_offset rsp, -16
+	call bkl_acquisisci
 	pop exc_error
 	.cfi_adjust_cfa_offset -8
 	call salva_stato
@@ -658,6 +937,7 @@ exc_stack_fault:
 	.cfi_def_cfa_offset 48
 	.cfi_offset rip, -40
 	.cfi_offset rsp, -16
+	call bkl_acquisisci
 	pop exc_error
 	.cfi_adjust_cfa_offset -8
 	call salva_stato
@@ -674,6 +954,7 @@ exc_prot_fault:
 	.cfi_def_cfa_offset 48
 	.cfi_offset rip, -40
 	.cfi_offset rsp, -16
+	call bkl_acquisisci
 	pop exc_error
 	.cfi_adjust_cfa_offset -8
 	call salva_stato
@@ -690,6 +971,7 @@ exc_page_fault:
 	.cfi_def_cfa_offset 48
 	.cfi_offset rip, -40
 	.cfi_offset rsp, -16
+	call bkl_acquisisci
 	pop exc_error
 	.cfi_adjust_cfa_offset -8
 	call salva_stato
@@ -720,6 +1002,7 @@ exc_ac:
 	.cfi_def_cfa_offset 48
 	.cfi_offset rip, -40
 	.cfi_offset rsp, -16
+	call bkl_acquisisci
 	pop exc_error
 	.cfi_adjust_cfa_offset -8
 	call salva_stato
@@ -805,6 +1088,24 @@ driver_td:
 	iretq
 	.cfi_endproc
 
+// richiesta di rischedulazione da parte di un altro processore
+	.extern c_driver_cpu
+driver_cpu:
+	.cfi_startproc
+	.cfi_def_cfa_offset 40
+	.cfi_offset rip, -40
+	.cfi_offset rsp, -16
+	call salva_stato
+	call c_driver_cpu
+	call apic_send_EOI
+	call carica_stato
+	iretq
+	.cfi_endproc
+
+// le interruzioni spurie non vanno confermate con EOI
+spurio:
+	iretq
+
 // predisponiamo tutti i possibili handler, ma non li inseriamo ancora nella
 // IDT perché non sappiamo la priorità.  Sarà la activate_pe() a predisporre
 // opportunamente i gate della IDT invocando la funzione load_handler()
@@ -1290,6 +1591,143 @@ end_program:
 	cli
 	hlt
 
+//////////////////////////////////////////////////////////////////////////
+// AVVIO DEGLI ALTRI PROCESSORI                                         //
+//////////////////////////////////////////////////////////////////////////
+
+// Il codice tra ap_tramp_inizio e ap_tramp_fine viene copiato da avvia_ap()
+// (in sistema.cpp) in una pagina sotto il primo MiB, il cui numero viene
+// inviato ai processori secondari con la sequenza INIT-SIPI-SIPI. Ogni
+// processore secondario parte in modo reale, con %cs che punta alla pagina,
+// e passa direttamente al modo a 64 bit usando i valori di CR0, CR3, CR4 ed
+// EFER del processore di avvio, che avvia_ap() ha scritto nella copia.
+// Tutti gli indirizzi usati in modo reale sono relativi all'inizio della
+// pagina. Tutti i processori secondari eseguono questo codice insieme, quindi
+// qui non si scrive in memoria.
+	.code16
+	.global ap_tramp_inizio, ap_tramp_fine
+	.global ap_tramp_gdt, ap_tramp_gdtr, ap_tramp_64, ap_tramp_salto
+	.global ap_tramp_cr0, ap_tramp_cr3, ap_tramp_cr4, ap_tramp_efer
+ap_tramp_inizio:
+	cli
+	movw %cs, %ax
+	movw %ax, %ds
+	lgdtl ap_tramp_gdtr - ap_tramp_inizio
+	movl ap_tramp_cr4 - ap_tramp_inizio, %eax
+	movl %eax, %cr4
+	movl ap_tramp_cr3 - ap_tramp_inizio, %eax
+	movl %eax, %cr3
+	movl $0xC0000080, %ecx		// EFER
+	movl ap_tramp_efer - ap_tramp_inizio, %eax
+	xorl %edx, %edx
+	wrmsr
+	// PE e PG insieme: con EFER.LME=1 passiamo al modo compatibile
+	movl ap_tramp_cr0 - ap_tramp_inizio, %eax
+	movl %eax, %cr0
+	// caricando il segmento codice a 64 bit passiamo al modo a 64 bit
+	ljmpl *(ap_tramp_salto - ap_tramp_inizio)
+
+	.code64
+ap_tramp_64:
+	// la pagina è mappata dalla finestra FM, ma ap_avvio va raggiunta
+	// con un salto assoluto
+	movq ap_tramp_entrata(%rip), %rax
+	jmp *%rax
+
+	.balign 8
+// GDT provvisoria: segmento nullo e segmento codice sistema a 64 bit (con
+// il bit A già a 1, in modo che il processore non debba scriverlo)
+ap_tramp_gdt:
+	.quad 0
+	.quad 0x00209B0000000000
+ap_tramp_gdtr:
+	.word 2*8-1
+	.long 0				// indirizzo fisico di ap_tramp_gdt
+ap_tramp_salto:
+	.long 0				// indirizzo fisico di ap_tramp_64
+	.word 8
+ap_tramp_cr0:
+	.long 0
+ap_tramp_cr3:
+	.long 0
+ap_tramp_cr4:
+	.long 0
+ap_tramp_efer:
+	.long 0
+	.balign 8
+ap_tramp_entrata:
+	.quad ap_avvio
+ap_tramp_fine:
+
+// Prima istruzione eseguita da ogni processore secondario nel modo a 64 bit.
+// Il processore si prende un indice in ap_arrivati (avvia_ap() lo porta a
+// MAX_CPU quando smette di aspettare, quindi chi arriva in ritardo si ferma),
+// passa alla sua pila di avvio e si registra. Poi aspetta il big kernel lock,
+// che il processore di avvio rilascia solo quando passa a main_sistema, e
+// completa l'inizializzazione in main_ap(), che sceglie il processo da
+// eseguire.
+ap_avvio:
+	movl $1, %eax
+	lock xaddl %eax, ap_arrivati
+	cmpl $(MAX_CPU - 1), %eax
+	jae ap_ferma
+	leal 1(%rax), %ebx		// indice del processore
+	movq %rbx, %rsp
+	shlq $12, %rsp
+	addq $pile_avvio, %rsp
+	xorl %eax, %eax
+	movw %ax, %ds
+	movw %ax, %es
+	movw %ax, %ss
+	movl %ebx, %edi
+	call ap_registra
+	call bkl_acquisisci
+	movl %ebx, %edi
+	call main_ap
+	call carica_stato
+	iretq
+
+ap_ferma:
+	cli
+1:	hlt
+	jmp 1b
+
+// carica la GDT (il cui descrittore è puntato da %rdi) e il segmento TSS di
+// selettore %si, quindi la IDT condivisa da tutti i processori
+	.global ap_carica_cpu
+ap_carica_cpu:
+	lgdt (%rdi)
+	pushq $SEL_CODICE_SISTEMA
+	pushq $1f
+	lretq
+1:	ltr %si
+	lidt idt_pointer
+	ret
+
+// funzioni usate da avvia_ap() per leggere lo stato del processore di avvio
+	.global leggi_cr0
+leggi_cr0:
+	movq %cr0, %rax
+	ret
+
+	.global leggi_cr4
+leggi_cr4:
+	movq %cr4, %rax
+	ret
+
+	.global leggi_efer
+leggi_efer:
+	movl $0xC0000080, %ecx
+	rdmsr
+	shlq $32, %rdx
+	orq %rdx, %rax
+	ret
+
+	.global salva_gdtr
+salva_gdtr:
+	sgdt (%rdi)
+	ret
+
 ////////////////////////////////////////////////////////////////
 // sezione dati                                               //
 ////////////////////////////////////////////////////////////////
@@ -1302,3 +1740,16 @@ exc_error:
 .global tss_punt_nucleo
 tss_punt_nucleo:
 	.quad 0
+// big kernel lock (si veda bkl_acquisisci)
+.global bkl
+	.balign 8
+bkl:
+	.long 0
+// numero di processori secondari che hanno raggiunto ap_avvio
+.global ap_arrivati
+ap_arrivati:
+	.long 0
+// pile usate dai processori secondari fino al primo carica_stato
+	.balign 4096
+pile_avvio:
+	.space (MAX_CPU - 1) * 4096, 0
@@ -0,0 +1,102 @@
+/*
+ * Confronto tra le mailbox del nucleo e la mailbox con semafori e
+ * memoria condivisa (si veda mailbox-dyn.cpp)
+ */
+
+#include <all.h>
+
+const natq N_MSG = 1000;
+const natq DIM_PICCOLO = 64;
+
+enum { SEMAFORI, PICCOLI, PAGINE_COPIATE, PAGINE, N_PROVE };
+const char* nomi[N_PROVE] = {
+	"semafori + memoria condivisa",
+	"mbox, 64 byte",
+	"mbox, pagina copiata",
+	"mbox, pagina rimappata",
+};
+
+extern natl produttore;
+
+extern natl consumatore;
+
+natl mb;
+natl via;
+natl mailbox_piena;
+natl mailbox_vuota;
+natb mailbox[DIM_PICCOLO];
+natq inizio;
+
+natq lunghezza(int p)
+{
+	return p == SEMAFORI || p == PICCOLI ? DIM_PICCOLO : DIM_PAGINA;
+}
+
+void pprod(natq a)
+{
+	// sulla pila, quindi in utente/privata
+	alignas(DIM_PAGINA) natb pagina[DIM_PAGINA + sizeof(natq)];
+
+	for (int p = 0; p < N_PROVE; p++) {
+		sem_wait(via);
+		// un buffer non allineato costringe il nucleo a copiare
+		natb* buf = (p == PAGINE_COPIATE ? pagina + sizeof(natq) : pagina);
+		natq len = lunghezza(p);
+		inizio = __builtin_ia32_rdtsc();
+		for (natq i = 0; i < N_MSG; i++) {
+			*reinterpret_cast<natq*>(buf) = i;
+			if (p == SEMAFORI) {
+				sem_wait(mailbox_vuota);
+				memcpy(mailbox, buf, len);
+				sem_signal(mailbox_piena);
+			} else {
+				mbox_send(mb, buf, len);
+			}
+		}
+	}
+
+	terminate_p();
+}
+
+void pcons(natq a)
+{
+	alignas(DIM_PAGINA) natb pagina[DIM_PAGINA + sizeof(natq)];
+
+	for (int p = 0; p < N_PROVE; p++) {
+		natb* buf = (p == PAGINE_COPIATE ? pagina + sizeof(natq) : pagina);
+		natq len = lunghezza(p);
+		natq errori = 0;
+		for (natq i = 0; i < N_MSG; i++) {
+			if (p == SEMAFORI) {
+				sem_wait(mailbox_piena);
+				memcpy(buf, mailbox, len);
+				sem_signal(mailbox_vuota);
+			} else {
+				mbox_recv(mb, buf, len);
+			}
+			if (*reinterpret_cast<natq*>(buf) != i)
+				errori++;
+		}
+		natq cicli = __builtin_ia32_rdtsc() - inizio;
+		printf("%-30s %8lu cicli/messaggio (%lu errori)\n",
+			nomi[p], cicli / N_MSG, errori);
+		sem_signal(via);
+	}
+	pause();
+
+	terminate_p();
+}
+natl produttore;
+natl consumatore;
+
+extern "C" void main()
+{
+	mb = mbox_ini(1);
+	via = sem_ini(1);
+	mailbox_piena = sem_ini(0);
+	mailbox_vuota = sem_ini(1);
+	produttore = activate_p(pprod, 0, 5, LIV_UTENTE);
+	consumatore = activate_p(pcons, 0, 5, LIV_UTENTE);
+
+	terminate_p();
+}
@@ -0,0 +1,166 @@
+#!/usr/bin/perl
+#
+# Decodifica il log binario (si veda la primitiva blog() in sysio.h) scritto
+# da ./run nel file blog.bin quando è definita la variabile CEBLOG.
+#
+# Uso:
+#
+#   util/blog.pl [-f] [-t] [FILE]
+#
+#   -f	continua ad attendere nuovi messaggi alla fine del file (come
+#	'tail -f'), per seguire il log mentre il sistema è in esecuzione
+#   -t	premetti a ogni messaggio il valore del TSC
+#
+# Se FILE non è specificato legge blog.bin. I messaggi vengono scritti nello
+# stesso formato del log testuale (livello, id, messaggio), in modo che
+# l'uscita possa essere passata a util/show_log.pl e util/colorlog.awk:
+#
+#   util/blog.pl -f | util/show_log.pl | awk -f util/colorlog.awk
+#
+# Il log contiene solo gli indirizzi dei formati: i formati, e le eventuali
+# stringhe passate con %s, vengono letti dagli eseguibili in build/. Lo
+# script va quindi lanciato dalla directory principale del nucleo. Le
+# stringhe che non si trovano negli eseguibili (per es. quelle costruite a
+# tempo di esecuzione) vengono mostrate come indirizzi.
+
+use strict;
+use warnings;
+no warnings 'portable';
+use Getopt::Std;
+
+do './util/start.pl' or die "util/start.pl non trovato (eseguire make)\n";
+do './util/simboli.pl' or die "util/simboli.pl: ", $@ || $!, "\n";
+
+my %opts;
+getopts('ft', \%opts) && @ARGV <= 1
+	or die "uso: $0 [-f] [-t] [FILE]\n";
+my $file = $ARGV[0] // 'blog.bin';
+
+$| = 1;
+
+# valori di log_sev
+my @sev = ('DBG', 'INF', 'WRN', 'ERR', 'USR');
+
+# valore del campo magic di ogni messaggio
+my $MAGIC = 0xB1;
+
+# lettura delle stringhe dagli eseguibili (exe_for() è in util/simboli.pl)
+
+# contenuto e segmenti caricabili di ogni eseguibile
+my %elf;
+sub load_elf($) {
+	my $exe = shift;
+	return $elf{$exe} if exists $elf{$exe};
+	$elf{$exe} = undef;
+	open(my $fh, '<:raw', $exe) or return;
+	local $/;
+	my $img = <$fh>;
+	close $fh;
+	substr($img, 0, 4) eq "\x7fELF" or return;
+	my ($phoff) = unpack('Q<', substr($img, 32, 8));
+	my ($phentsize, $phnum) = unpack('v v', substr($img, 54, 4));
+	my @seg;
+	for my $i (0 .. $phnum - 1) {
+		my ($type, $flags, $off, $vaddr, $paddr, $filesz) =
+			unpack('V V Q< Q< Q< Q<', substr($img, $phoff + $i * $phentsize, 40));
+		push @seg, [ $vaddr, $off, $filesz ] if $type == 1; # PT_LOAD
+	}
+	return $elf{$exe} = { img => \$img, seg => \@seg };
+}
+
+sub read_str($) {
+	my $a = shift;
+	my $e = load_elf(exe_for($a)) or return;
+	for my $s (@{$e->{seg}}) {
+		my ($vaddr, $off, $filesz) = @$s;
+		next unless $a >= $vaddr && $a < $vaddr + $filesz;
+		my $start = $off + $a - $vaddr;
+		my $end = index(${$e->{img}}, "\0", $start);
+		return if $end < 0;
+		return substr(${$e->{img}}, $start, $end - $start);
+	}
+	return;
+}
+
+# conversione di un argomento in base alla dimensione specificata nel formato
+sub signed($$) {
+	my ($v, $len) = @_;
+	return unpack('q<', pack('Q<', $v)) if $len =~ /^(l|ll|z)$/;
+	return unpack('s<', pack('Q<', $v)) if $len eq 'h';
+	return unpack('c',  pack('Q<', $v)) if $len eq 'hh';
+	return unpack('l<', pack('Q<', $v));
+}
+
+sub unsigned($$) {
+	my ($v, $len) = @_;
+	return $v              if $len =~ /^(l|ll|z)$/;
+	return $v & 0xFFFF     if $len eq 'h';
+	return $v & 0xFF       if $len eq 'hh';
+	return $v & 0xFFFFFFFF;
+}
+
+# formattazione di un messaggio: le conversioni del formato C vengono
+# tradotte in conversioni di sprintf, senza i modificatori di lunghezza
+sub format_msg($@) {
+	my ($fmt, @args) = @_;
+	my $next = sub { return @args ? shift @args : 0 };
+	$fmt =~ s{%([-+ #0]*)(\d+|\*)?(?:\.(\d+|\*))?(hh|h|ll|l|z)?([diouxXcsp%])}{
+		my ($flags, $w, $p, $len, $conv) = ($1, $2 // '', $3, $4 // '', $5);
+		if ($conv eq '%') {
+			'%';
+		} else {
+			$w = $next->() if $w eq '*';
+			$p = $next->() if defined $p && $p eq '*';
+			my $spec = '%' . $flags . $w . (defined $p ? ".$p" : '');
+			my $v = $next->();
+			if ($conv =~ /[di]/) {
+				sprintf("${spec}d", signed($v, $len));
+			} elsif ($conv =~ /[ouxX]/) {
+				sprintf("$spec$conv", unsigned($v, $len));
+			} elsif ($conv eq 'c') {
+				sprintf("${spec}c", $v & 0xFF);
+			} elsif ($conv eq 'p') {
+				sprintf("${spec}s", sprintf('0x%x', $v));
+			} else {
+				my $s = read_str($v);
+				sprintf("${spec}s", defined $s ? $s : sprintf('0x%x', $v));
+			}
+		}
+	}ge;
+	return $fmt;
+}
+
+open(my $fh, '<:raw', $file) or die "$file: $!\n";
+my $buf = '';
+while (1) {
+	my $r = read($fh, $buf, 65536, length $buf);
+	die "$file: $!\n" unless defined $r;
+	if (!$r) {
+		last unless $opts{f};
+		sleep 1;
+		seek($fh, 0, 1);	# azzera la condizione di fine file
+		next;
+	}
+	while (length $buf >= 24) {
+		my ($magic, $sev, $n, $pad, $id, $tsc, $fmt) = unpack('C C C C V Q< Q<', $buf);
+		if ($magic != $MAGIC) {
+			# risincronizzazione
+			substr($buf, 0, 1) = '';
+			next;
+		}
+		last if length $buf < 24 + 8 * $n;
+		my @args = unpack("(Q<)$n", substr($buf, 24, 8 * $n));
+		substr($buf, 0, 24 + 8 * $n) = '';
+
+		my $msg;
+		if (!$fmt) {
+			$msg = "($args[0] messaggi persi)";
+		} else {
+			my $f = read_str($fmt);
+			$msg = defined $f ? format_msg($f, @args) :
+				sprintf('formato 0x%x sconosciuto', $fmt);
+		}
+		$msg = "[$tsc] $msg" if $opts{t};
+		printf "%s\t%d\t%s\n", $sev[$sev] // $sev, $id, $msg;
+	}
+}
@@ -21,6 +21,7 @@ int main()
 	ofstream startgdb("util/tmp.gdb");
 	startgdb << "set $MAX_LIV="      	<< MAX_LIV << endl;
 	startgdb << "set $MAX_SEM="      	<< MAX_SEM << endl;
+	startgdb << "set $MAX_MUTEX="    	<< MAX_MUTEX << endl;
 	startgdb << "set $SEL_CODICE_SISTEMA="  << SEL_CODICE_SISTEMA << endl;
 	startgdb << "set $SEL_CODICE_UTENTE="   << SEL_CODICE_UTENTE << endl;
 	startgdb << "set $SEL_DATI_UTENTE="     << SEL_DATI_UTENTE << endl;
@@ -32,6 +33,11 @@ int main()
 	startgdb << "set $I_MIO_C="		<< I_MIO_C << endl;
 	startgdb << "set $I_UTN_C="		<< I_UTN_C << endl;
 	startgdb << "set $I_UTN_P="		<< I_UTN_P << endl;
+	startgdb << "set $N_SIS_C="		<< N_SIS_C << endl;
+	startgdb << "set $N_SIS_P="		<< N_SIS_P << endl;
+	startgdb << "set $N_MIO_C="		<< N_MIO_C << endl;
+	startgdb << "set $N_UTN_C="		<< N_UTN_C << endl;
+	startgdb << "set $N_UTN_P="		<< N_UTN_P << endl;
 	startgdb.close();
 
 	ofstream startpl("util/start.pl");
@@ -0,0 +1,83 @@
+#!/usr/bin/perl
+#
+# Elabora il profilo a campionamento del nucleo, salvato con il comando
+# 'profile dump FILE' del debugger.
+#
+# Uso:
+#
+#   util/profile.pl FILE		profilo piatto
+#   util/profile.pl -f FILE		pile "ripiegate" (folded stacks)
+#
+# Il profilo piatto mostra, per ogni funzione, la percentuale di campioni in
+# cui si trovava in esecuzione (self) e quella in cui compariva nel
+# backtrace (totale). Con -f l'uscita è nel formato accettato da
+# flamegraph.pl (https://github.com/brendangregg/FlameGraph):
+#
+#   util/profile.pl -f FILE | flamegraph.pl > profilo.svg
+#
+# Ogni pila inizia con l'id del processo, in modo che il grafico abbia una
+# colonna per ogni processo.
+#
+# Gli indirizzi vengono convertiti usando gli eseguibili in build/, con una
+# sola invocazione di addr2line per ogni eseguibile (si veda util/simboli.pl).
+# Lo script va quindi lanciato dalla directory principale del nucleo.
+
+use strict;
+use warnings;
+no warnings 'portable';
+use Getopt::Std;
+
+our %sym;
+do './util/start.pl' or die "util/start.pl non trovato (eseguire make)\n";
+do './util/simboli.pl' or die "util/simboli.pl: ", $@ || $!, "\n";
+
+my %opts;
+getopts('f', \%opts) && @ARGV == 1
+	or die "uso: $0 [-f] FILE\n";
+
+# lettura del file: intestazione (magic, versione, profondità, numero di
+# campioni, campioni persi) seguita dai campioni (conta, id, livello,
+# numero di indirizzi, indirizzi), tutto in little endian
+open(my $fh, '<:raw', $ARGV[0]) or die "$ARGV[0]: $!\n";
+read($fh, my $hdr, 24) == 24 or die "$ARGV[0]: file troppo corto\n";
+my ($magic, $ver, $depth, $n, $persi) = unpack('a4 V V V Q<', $hdr);
+$magic eq 'NPRF' && $ver == 1 or die "$ARGV[0]: formato non riconosciuto\n";
+my $dim = 16 + 8 * $depth;
+my @camp;
+while (read($fh, my $buf, $dim) == $dim) {
+	my ($conta, $id, $liv, $prof, @pc) = unpack("Q< V C C x2 (Q<)$depth", $buf);
+	push @camp, { conta => $conta, id => $id, liv => $liv, pc => [ @pc[0 .. $prof - 1] ] };
+}
+close $fh;
+
+# conversione degli indirizzi
+symbolize(map { @{$_->{pc}} } @camp);
+
+if ($opts{f}) {
+	my %folded;
+	for my $c (@camp) {
+		my $s = join(';', "proc $c->{id}", map { $sym{$_} } reverse @{$c->{pc}});
+		$folded{$s} += $c->{conta};
+	}
+	print "$_ $folded{$_}\n" for sort keys %folded;
+	exit 0;
+}
+
+my ($tot, %self, %totale) = (0);
+for my $c (@camp) {
+	my @f = map { $sym{$_} } @{$c->{pc}};
+	$tot += $c->{conta};
+	$self{$f[0]} += $c->{conta};
+	# una funzione ricorsiva va contata una volta sola
+	my %in;
+	$totale{$_} += $c->{conta} for grep { !$in{$_}++ } @f;
+}
+$tot or die "$ARGV[0]: nessun campione\n";
+
+printf "campioni: %d (persi: %d)\n\n", $tot, $persi;
+printf "%7s %8s %7s %8s  %s\n", 'self%', 'self', 'tot%', 'totale', 'funzione';
+for my $f (sort { $totale{$b} <=> $totale{$a} || $a cmp $b } keys %totale) {
+	my $s = $self{$f} // 0;
+	printf "%6.2f%% %8d %6.2f%% %8d  %s\n",
+		100 * $s / $tot, $s, 100 * $totale{$f} / $tot, $totale{$f}, $f;
+}
@@ -2,26 +2,26 @@
 
 BEGIN {
 	do './util/start.pl';
+	# exe_for() e addr2line()
+	do './util/simboli.pl';
 
 	$| = 1;
+	# un addr2line terminato non deve interrompere lo script
+	$SIG{PIPE} = 'IGNORE';
 
 	my $hex = qr/[a-fA-F0-9]/;
 
+	# indirizzi già convertiti
+	my %cache;
+
 	sub toLine($) {
-		my $h = shift;
+		my $h = lc shift;
 
-		if    (hex($h) >= hex($START_UTENTE))	{ $exe = 'build/utente';  }
-		elsif (hex($h) >= hex($START_IO))	{ $exe = 'build/io';      }
-		else 				      	{ $exe = "build/sistema"; }
+		return $cache{$h} if exists $cache{$h};
 
-		my $out = `$CE_ADDR2LINE -Cfe $exe $h`;
-		if ($?) {
-			return "0x$h";
-		}
-		chomp $out;
-		my @lines = split(/\n/, $out);
-		if ($lines[1] =~ /^\?\?/) {
-			return "0x$h";
+		my @lines = addr2line(hex($h));
+		if (!@lines || $lines[1] =~ /^\?\?/) {
+			return $cache{$h} = "0x$h";
 		}
 		my $s = '';
 		$lines[1] =~ s#^.*/##;
@@ -29,7 +29,7 @@ BEGIN {
 			$s .= $lines[0];
 		}
 		$s .= ' [' . $lines[1] . ']';
-		return $s;
+		return $cache{$h} = $s;
 	}
 
 	sub decodeAddr($) {
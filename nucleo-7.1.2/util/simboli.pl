@@ -0,0 +1,90 @@
+#
+# Conversione degli indirizzi del nucleo in nomi di funzione, comune a
+# util/profile.pl, util/trace2json.pl, util/blog.pl e util/show_log.pl.
+#
+# Va caricato con 'do', dopo util/start.pl:
+#
+#   do './util/start.pl' or die ...;
+#   do './util/simboli.pl' or die ...;
+#
+# Gli indirizzi vengono convertiti usando gli eseguibili in build/, quindi
+# gli script vanno lanciati dalla directory principale del nucleo.
+
+use strict;
+use warnings;
+no warnings 'portable';
+use IPC::Open2;
+
+our ($START_IO, $START_UTENTE, $CE_ADDR2LINE);
+
+# eseguibile che contiene l'indirizzo
+sub exe_for($) {
+	my $a = shift;
+	return 'build/utente'  if $a >= hex($START_UTENTE);
+	return 'build/io'      if $a >= hex($START_IO);
+	return 'build/sistema';
+}
+
+# nomi degli indirizzi convertiti da symbolize(): la funzione, se nota,
+# altrimenti il file sorgente, altrimenti l'indirizzo stesso
+our %sym;
+
+# converte tutti gli indirizzi passati, con una sola invocazione di
+# addr2line per ogni eseguibile, e li aggiunge a %sym
+sub symbolize(@) {
+	my %per_exe;
+	push @{$per_exe{exe_for($_)}}, $_ for grep { !exists $sym{$_} } @_;
+	for my $exe (keys %per_exe) {
+		my %seen;
+		my @a = grep { !$seen{$_}++ } @{$per_exe{$exe}};
+		# a blocchi, per non superare la lunghezza massima
+		# della riga di comando
+		while (my @blk = splice(@a, 0, 512)) {
+			my @out = `$CE_ADDR2LINE -Cfe $exe @{[ map { sprintf '%x', $_ } @blk ]}`;
+			chomp @out;
+			for my $i (0 .. $#blk) {
+				my ($f, $l) = @out[2 * $i, 2 * $i + 1];
+				$l //= '??';
+				$l =~ s#^.*/##;
+				$sym{$blk[$i]} =
+					defined $f && $f ne '??' ? $f :
+					$l !~ /^\?\?/            ? $l :
+					sprintf('0x%x', $blk[$i]);
+			}
+		}
+	}
+}
+
+# un processo addr2line per ogni eseguibile, lanciato alla prima richiesta e
+# poi riusato per tutti gli indirizzi successivi (per chi riceve gli
+# indirizzi uno alla volta, come util/show_log.pl)
+my %a2l;
+
+# restituisce (funzione, file:riga) per l'indirizzo $a (un numero), o la
+# lista vuota se addr2line non è disponibile
+sub addr2line($) {
+	my $a = shift;
+	my $exe = exe_for($a);
+
+	if (!exists $a2l{$exe}) {
+		my ($in, $out);
+		my $pid = eval { open2($out, $in, "$CE_ADDR2LINE -Cfe $exe") };
+		$a2l{$exe} = $pid ? [ $in, $out ] : undef;
+	}
+	my $p = $a2l{$exe} or return;
+	my ($in, $out) = @$p;
+	# addr2line svuota il buffer di uscita dopo ogni indirizzo
+	# letto da stdin
+	printf $in "%x\n", $a;
+	my $func = <$out>;
+	my $line = <$out>;
+	if (!defined $line) {
+		# il processo è terminato (per es. eseguibile mancante)
+		$a2l{$exe} = undef;
+		return;
+	}
+	chomp($func, $line);
+	return ($func, $line);
+}
+
+1;
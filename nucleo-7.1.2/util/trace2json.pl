@@ -0,0 +1,139 @@
+#!/usr/bin/perl
+#
+# Converte una traccia degli eventi del nucleo, salvata con il comando
+# 'traccia dump FILE' del debugger, nel formato JSON degli eventi di Chrome,
+# visualizzabile con chrome://tracing oppure https://ui.perfetto.dev
+#
+# Uso:
+#
+#   util/trace2json.pl [-m MHZ] FILE > traccia.json
+#
+# MHZ è la frequenza del TSC in MHz (default 1000), usata per convertire i
+# cicli in microsecondi.
+#
+# Il risultato contiene un gruppo per ogni processore e, dentro ogni gruppo,
+# una traccia per ogni processo che vi è stato eseguito, in cui si vedono gli
+# intervalli passati in esecuzione, quelli passati nel nucleo (con il nome
+# dello stub da cui si è entrati, per es. a_sem_wait o handler_1), i blocchi
+# e i risvegli sui semafori. Un contatore, in un gruppo a parte, mostra il
+# numero di frame allocati durante la traccia.
+#
+# Gli indirizzi vengono convertiti usando gli eseguibili in build/, con una
+# sola invocazione di addr2line per ogni eseguibile (si veda util/simboli.pl).
+# Lo script va quindi lanciato dalla directory principale del nucleo.
+
+use strict;
+use warnings;
+no warnings 'portable';
+use Getopt::Std;
+
+our %sym;
+do './util/start.pl' or die "util/start.pl non trovato (eseguire make)\n";
+do './util/simboli.pl' or die "util/simboli.pl: ", $@ || $!, "\n";
+
+my %opts;
+getopts('m:', \%opts) && @ARGV == 1
+	or die "uso: $0 [-m MHZ] FILE\n";
+my $mhz = $opts{m} // 1000;
+
+# tipi di evento (enum tipo_evento in sistema.cpp)
+use constant {
+	EV_ENTRATA		=> 0,
+	EV_USCITA		=> 1,
+	EV_CAMBIO		=> 2,
+	EV_BLOCCO		=> 3,
+	EV_RISVEGLIO		=> 4,
+	EV_ALLOCA_FRAME		=> 5,
+	EV_RILASCIA_FRAME	=> 6,
+};
+
+# lettura del file: intestazione (magic, versione, numero di eventi) seguita
+# dagli eventi (tsc, tipo, cpu, a, b), tutto in little endian
+open(my $fh, '<:raw', $ARGV[0]) or die "$ARGV[0]: $!\n";
+read($fh, my $hdr, 12) == 12 or die "$ARGV[0]: file troppo corto\n";
+my ($magic, $ver, $n) = unpack('a4 V V', $hdr);
+$magic eq 'NTRC' && $ver == 2 or die "$ARGV[0]: formato non riconosciuto\n";
+my @ev;
+while (read($fh, my $buf, 24) == 24) {
+	push @ev, [ unpack('Q< v v V Q<', $buf) ];
+}
+close $fh;
+@ev or exit 0;
+
+# conversione degli indirizzi
+symbolize(map { $_->[4] } grep { $_->[1] == EV_ENTRATA } @ev);
+
+# scrittura degli eventi
+my $t0 = $ev[0][0];
+sub ts($) { return sprintf('%.3f', ($_[0] - $t0) / $mhz); }
+
+sub jstr($) {
+	my $s = shift;
+	$s =~ s/(["\\])/\\$1/g;
+	return "\"$s\"";
+}
+
+# Ogni processore diventa un "processo" di Chrome (pid uguale all'indice del
+# processore) e ogni processo del nucleo una sua traccia (tid uguale all'id).
+# Il contatore dei frame, che è unico, ha un gruppo a parte.
+use constant PID_FRAME => 0x10000;
+
+my @out;
+my %tids;	# $tids{$cpu}{$pid}: tracce da nominare
+sub slice($$$$$) {
+	my ($cpu, $pid, $name, $beg, $end) = @_;
+	$tids{$cpu}{$pid} = 1;
+	push @out, sprintf('{"name":%s,"ph":"X","pid":%u,"tid":%u,"ts":%s,"dur":%.3f}',
+		jstr($name), $cpu, $pid, ts($beg), ($end - $beg) / $mhz);
+}
+
+sub instant($$$$) {
+	my ($cpu, $pid, $name, $t) = @_;
+	$tids{$cpu}{$pid} = 1;
+	push @out, sprintf('{"name":%s,"ph":"i","s":"t","pid":%u,"tid":%u,"ts":%s}',
+		jstr($name), $cpu, $pid, ts($t));
+}
+
+# su ogni processore gli intervalli nel nucleo non si annidano, perché il
+# nucleo esegue con le interruzioni disabilitate; gli eventi dei diversi
+# processori, invece, si alternano nel buffer, quindi teniamo lo stato
+# separato per ogni processore
+my (%k_beg, %k_pid, %k_name);	# intervallo corrente nel nucleo
+my (%u_beg, %u_pid);		# intervallo corrente in esecuzione
+my $frame = 0;
+for my $e (@ev) {
+	my ($t, $tipo, $cpu, $a, $b) = @$e;
+	if ($tipo == EV_ENTRATA) {
+		slice($cpu, $u_pid{$cpu}, 'esecuzione', $u_beg{$cpu}, $t) if defined $u_pid{$cpu};
+		delete $u_pid{$cpu};
+		($k_beg{$cpu}, $k_pid{$cpu}, $k_name{$cpu}) = ($t, $a, $sym{$b});
+	} elsif ($tipo == EV_USCITA) {
+		slice($cpu, $k_pid{$cpu}, $k_name{$cpu}, $k_beg{$cpu}, $t) if defined $k_pid{$cpu};
+		delete $k_pid{$cpu};
+		($u_beg{$cpu}, $u_pid{$cpu}) = ($t, $a);
+	} elsif ($tipo == EV_CAMBIO) {
+		instant($cpu, $b, $a == 0xFFFFFFFF ? 'entra' : "entra (da $a)", $t);
+	} elsif ($tipo == EV_BLOCCO) {
+		instant($cpu, $a, "blocco sem[$b]", $t);
+	} elsif ($tipo == EV_RISVEGLIO) {
+		instant($cpu, $a, "risveglio sem[$b]", $t);
+	} elsif ($tipo == EV_ALLOCA_FRAME || $tipo == EV_RILASCIA_FRAME) {
+		$frame += $tipo == EV_ALLOCA_FRAME ? 1 : -1;
+		push @out, sprintf('{"name":"frame allocati","ph":"C","pid":%u,"ts":%s,"args":{"frame":%d}}',
+			PID_FRAME, ts($t), $frame);
+	}
+}
+
+for my $cpu (sort { $a <=> $b } keys %tids) {
+	push @out, sprintf('{"name":"process_name","ph":"M","pid":%u,"args":{"name":"cpu %u"}}',
+		$cpu, $cpu);
+	push @out, sprintf('{"name":"process_sort_index","ph":"M","pid":%u,"args":{"sort_index":%u}}',
+		$cpu, $cpu);
+	for my $pid (sort { $a <=> $b } keys %{$tids{$cpu}}) {
+		push @out, sprintf('{"name":"thread_name","ph":"M","pid":%u,"tid":%u,"args":{"name":"proc %u"}}',
+			$cpu, $pid, $pid);
+	}
+}
+push @out, sprintf('{"name":"process_name","ph":"M","pid":%u,"args":{"name":"memoria"}}', PID_FRAME);
+
+print "{\"traceEvents\":[\n", join(",\n", @out), "\n]}\n";
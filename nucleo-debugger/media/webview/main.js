@@ -1,24 +1,464 @@
 // @ts-nocheck
 // This script will be run within the webview itself
 // It cannot access the main VS Code APIs directly.
+//
+// The processes are rendered here with the templates in templates/,
+// precompiled in templates.js by 'yarn run templates'. Only the processes
+// that are visible (plus a few above and below) are in the DOM, and the
+// stack and registers of a process are asked to nucleoweb.ts only when the
+// user opens them. The same holds for the other sections (semaphores,
+// timer queue, frames): nucleoweb.ts sends their contents only while they
+// are open.
 
 (function () {
-    document.addEventListener('DOMContentLoaded', (event) => {
-        // Toggle Campi Aggiuntivi
-        const toggles = document.querySelectorAll('.toggle');
-        var icon = document.createElement('i');
-        icon.className = 'codicon codicon-chevron-down';
-        toggles.forEach((button) => {
+    const vscode = acquireVsCodeApi();
+    const templates = Handlebars.templates;
+
+    // height of a process not yet measured (closed)
+    const ROW_HEIGHT = 24;
+    // processes rendered above and below the visible ones
+    const OVERSCAN = 10;
+
+    // processes, by pid, as sent by nucleoweb.ts
+    const procs = new Map();
+    // dump of the stack and registers, by pid (vecchi: from a previous stop)
+    const dettagli = new Map();
+    // indices of the open toggles of each process, by pid
+    const aperti = new Map();
+    // measured height of each process, by pid
+    const altezze = new Map();
+    // pids of the processes whose stack, registers or memory map are open
+    const conDettagli = new Set();
+
+    // Add the chevron to the toggles under root that do not have one yet
+    function addIcons(root) {
+        root.querySelectorAll('.toggle').forEach((button) => {
+            if (button.classList.contains('icon')) {
+                return;
+            }
             button.classList.add("icon");
-            let tmp = button.innerHTML;
-            tmp ='<i class="codicon codicon-chevron-down rotate"></i>' + tmp;
-            button.innerHTML = tmp;
-            button.addEventListener('click', (event) => {
-                button.firstChild.classList.toggle('rotate');
-                button.parentNode.classList.toggle('toggled');
+            button.innerHTML = '<i class="codicon codicon-chevron-down rotate"></i>' + button.innerHTML;
+        });
+    }
+
+    function fillDetails(node, pid) {
+        const d = dettagli.get(pid);
+        node.querySelectorAll('[data-dump]').forEach((ul) => {
+            ul.innerHTML = templates[ul.dataset.template || 'dump'](d ? d[ul.dataset.dump] : {});
+        });
+    }
+
+    // true if the stack, the registers or the memory map of the process in node are open
+    function detailsOpen(node) {
+        return Array.from(node.querySelectorAll('[data-dump]')).some((ul) => ul.parentNode.classList.contains('toggled'));
+    }
+
+    function requestDetails(pid) {
+        vscode.postMessage({ command: 'dettagli', pid: pid });
+    }
+
+    function createNode(pid) {
+        const tmp = document.createElement('div');
+        tmp.innerHTML = templates.process(procs.get(pid)).trim();
+        const node = tmp.firstChild;
+        addIcons(node);
+        const open = aperti.get(pid);
+        if (open) {
+            node.querySelectorAll('.toggle').forEach((button, i) => {
+                if (open.has(i)) {
+                    button.firstChild.classList.remove('rotate');
+                    button.parentNode.classList.add('toggled');
+                }
+            });
+        }
+        fillDetails(node, pid);
+        return node;
+    }
+
+    // A section of the process list: the processes outside the window are
+    // replaced by the padding of the section
+    class VirtualList {
+        constructor(el) {
+            this.el = el;
+            this.pids = [];
+            this.nodes = new Map();
+        }
+
+        setPids(pids) {
+            this.pids = pids;
+        }
+
+        // forget the node of a process, so that it is rendered again
+        invalidate(pid) {
+            const node = this.nodes.get(pid);
+            if (node) {
+                node.remove();
+                this.nodes.delete(pid);
+            }
+        }
+
+        render() {
+            // nothing to do if the section is closed
+            if (!this.el.offsetParent) {
+                return false;
+            }
+            const top = this.el.getBoundingClientRect().top;
+            const viewTop = -top, viewBottom = window.innerHeight - top;
+            let y = 0, first = -1, last = -1;
+            const start = [];
+            this.pids.forEach((pid, i) => {
+                const h = altezze.get(pid) ?? ROW_HEIGHT;
+                start.push(y);
+                if (first < 0 && y + h > viewTop) {
+                    first = i;
+                }
+                if (y < viewBottom) {
+                    last = i;
+                }
+                y += h;
             });
+            const total = y;
+            if (first < 0) {
+                first = this.pids.length;
+            }
+            first = Math.max(0, first - OVERSCAN);
+            last = Math.min(this.pids.length - 1, last + OVERSCAN);
+
+            const shown = new Set(this.pids.slice(first, last + 1));
+            for (const [pid, node] of this.nodes) {
+                if (!shown.has(pid)) {
+                    node.remove();
+                    this.nodes.delete(pid);
+                }
+            }
+            let prev = null;
+            for (let i = first; i <= last; i++) {
+                const pid = this.pids[i];
+                let node = this.nodes.get(pid);
+                if (!node) {
+                    node = createNode(pid);
+                    this.nodes.set(pid, node);
+                }
+                const next = prev ? prev.nextSibling : this.el.firstChild;
+                if (node !== next) {
+                    this.el.insertBefore(node, next);
+                }
+                prev = node;
+            }
+            const padTop = first <= last ? start[first] : total;
+            const padBottom = first <= last ? total - start[last] - (altezze.get(this.pids[last]) ?? ROW_HEIGHT) : 0;
+            this.el.style.paddingTop = padTop + 'px';
+            this.el.style.paddingBottom = padBottom + 'px';
+
+            // measure what has been rendered
+            let changed = false;
+            for (const [pid, node] of this.nodes) {
+                const h = node.getBoundingClientRect().height;
+                if (h !== altezze.get(pid)) {
+                    altezze.set(pid, h);
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+    }
+
+    const lists = {};
+
+    // size of a frame in the frame map, and space between frames
+    const FRAME_SIZE = 6;
+    const FRAME_GAP = 1;
+    // last contents of the frame map
+    let frameData = undefined;
+
+    // Draw the state of the M2 frames, one square per frame
+    function drawFrames() {
+        const canvas = document.getElementById('frame');
+        if (!frameData || !canvas.offsetParent) {
+            return;
+        }
+        const step = FRAME_SIZE + FRAME_GAP;
+        const n = frameData.frame.length;
+        const cols = Math.max(1, Math.floor(canvas.parentNode.clientWidth / step));
+        canvas.width = cols * step;
+        canvas.height = Math.ceil(n / cols) * step;
+        // the colors are those of the legend, which follow the theme
+        const color = (c) => getComputedStyle(document.querySelector('.f-' + c)).backgroundColor;
+        const libero = color('libero'), pagina = color('pagina'), tabella = color('tabella');
+        const ctx = canvas.getContext('2d');
+        frameData.frame.forEach((v, i) => {
+            ctx.globalAlpha = v > 0 ? 0.3 + 0.7 * Math.min(v, 512) / 512 : 1;
+            ctx.fillStyle = v < 0 ? libero : v == 0 ? pagina : tabella;
+            ctx.fillRect((i % cols) * step, Math.floor(i / cols) * step, FRAME_SIZE, FRAME_SIZE);
+        });
+        ctx.globalAlpha = 1;
+    }
+
+    // History of the scheduler state, recorded by the 'timeline' command:
+    // the state before the first change, and the changes as deltas
+    let storia = { base: null, entries: [] };
+    // states after some of the changes, to avoid applying all the deltas
+    // from the beginning at each step
+    const STORIA_PASSO = 256;
+    let storiaCache = new Map();
+    // change shown, or -1 to follow the last one
+    let storiaPos = -1;
+
+    function applyDelta(state, d) {
+        const s = Object.assign({}, state, { sem: Object.assign({}, state.sem) });
+        for (const k in d) {
+            if (k != 'sem') {
+                s[k] = d[k];
+                continue;
+            }
+            for (const i in d.sem) {
+                if (d.sem[i] === null) {
+                    delete s.sem[i];
+                } else {
+                    s.sem[i] = d.sem[i];
+                }
+            }
+        }
+        return s;
+    }
+
+    // the state after change k (index in storia.entries)
+    function storiaState(k) {
+        let j = k - (k + 1) % STORIA_PASSO;
+        let s = j >= 0 ? storiaCache.get(j) : storia.base;
+        if (!s) {
+            j = -1;
+            s = storia.base;
+        }
+        for (j++; j <= k; j++) {
+            s = applyDelta(s, storia.entries[j].delta);
+            if ((j + 1) % STORIA_PASSO == 0) {
+                storiaCache.set(j, s);
+            }
+        }
+        return s;
+    }
+
+    function renderStoria() {
+        const n = storia.entries.length;
+        const k = storiaPos < 0 ? n - 1 : storiaPos;
+        const slider = document.getElementById('storia-pos');
+        slider.max = Math.max(0, n - 1);
+        slider.value = Math.max(0, k);
+        document.getElementById('storia-count').textContent = n ? `: ${k + 1}/${n}` : '';
+        if (!storia.base) {
+            return;
+        }
+        const stato = k >= 0 ? storiaState(k) : storia.base;
+        document.getElementById('storia').innerHTML = templates.storia({
+            entry: k >= 0 ? storia.entries[k] : null,
+            stato: stato,
+            // show the processor index only if there is more than one
+            smp: stato.esecuzione.length > 1,
         });
+    }
+
+    function updateStoria(dati) {
+        if (dati.base) {
+            storia = { base: dati.base, entries: [] };
+            storiaCache = new Map();
+        }
+        storia.entries.push(...dati.entries);
+        renderStoria();
+    }
+
+    function moveStoria(k) {
+        const n = storia.entries.length;
+        k = Math.min(Math.max(k, 0), n - 1);
+        storiaPos = k == n - 1 ? -1 : k;
+        renderStoria();
+    }
+
+    // Show the contents of a section, sent by nucleoweb.ts
+    function updateSection(msg) {
+        const dati = msg.dati;
+        switch (msg.nome) {
+            case 'semafori':
+                document.getElementById('semafori').innerHTML = templates.semafori(dati);
+                break;
+            case 'sospesi':
+                document.getElementById('sospesi').innerHTML = templates.sospesi(dati);
+                break;
+            case 'storia':
+                updateStoria(dati);
+                break;
+            case 'frame':
+                frameData = dati;
+                document.getElementById('frame-count').textContent = `: ${dati.frame.length} (${dati.liberi} liberi)`;
+                drawFrames();
+                break;
+        }
+    }
+
+    let renderPending = false;
+    function renderAll() {
+        if (renderPending) {
+            return;
+        }
+        renderPending = true;
+        requestAnimationFrame(() => {
+            renderPending = false;
+            let changed = false;
+            Object.values(lists).forEach((l) => {
+                changed = l.render() || changed;
+            });
+            // the heights have changed: the window may show other processes
+            if (changed) {
+                renderAll();
+            }
+        });
+    }
+
+    function updateCounts() {
+        let tot = 0;
+        ['sistema', 'utente'].forEach((s) => {
+            const n = lists[s].pids.length;
+            document.getElementById(s + '-count').textContent = ': ' + n;
+            tot += n;
+        });
+        document.getElementById('proc-count').textContent = ': ' + tot;
+    }
+
+    // Apply an update of the process list sent by nucleoweb.ts
+    function updateProcesses(msg) {
+        if (msg.reset) {
+            procs.clear();
+            Object.values(lists).forEach((l) => {
+                l.nodes.forEach((node) => node.remove());
+                l.nodes.clear();
+            });
+        }
+        msg.remove.forEach((pid) => {
+            procs.delete(pid);
+            dettagli.delete(pid);
+            aperti.delete(pid);
+            altezze.delete(pid);
+            conDettagli.delete(pid);
+            Object.values(lists).forEach((l) => l.invalidate(pid));
+        });
+        msg.add.forEach((p) => {
+            procs.set(p.pid, p);
+            Object.values(lists).forEach((l) => l.invalidate(p.pid));
+        });
+
+        // the target has stopped again: the stack and registers are old
+        dettagli.forEach((d) => {
+            d.vecchi = true;
+        });
+        conDettagli.forEach(requestDetails);
+
+        const pids = { sistema: [], utente: [] };
+        Array.from(procs.keys()).sort((a, b) => a - b).forEach((pid) => {
+            pids[procs.get(pid).livello == "sistema" ? 'sistema' : 'utente'].push(pid);
+        });
+        lists.sistema.setPids(pids.sistema);
+        lists.utente.setPids(pids.utente);
+        updateCounts();
+        renderAll();
+    }
+
+    function updateDetails(msg) {
+        dettagli.set(msg.pid, { pila_dmp: msg.pila_dmp, reg_dmp: msg.reg_dmp, regioni: msg.regioni, vecchi: false });
+        Object.values(lists).forEach((l) => {
+            const node = l.nodes.get(msg.pid);
+            if (node) {
+                fillDetails(node, msg.pid);
+            }
+        });
+        renderAll();
+    }
+
+    // Toggle Campi Aggiuntivi (also for the processes added later)
+    document.addEventListener('click', (event) => {
+        const button = event.target.closest('.toggle');
+        if (!button) {
+            return;
+        }
+        button.firstChild.classList.toggle('rotate');
+        button.parentNode.classList.toggle('toggled');
+
+        const sezione = button.parentNode.dataset.sezione;
+        if (sezione) {
+            vscode.postMessage({ command: 'sezione', nome: sezione, aperta: button.parentNode.classList.contains('toggled') });
+            if (sezione == 'frame') {
+                drawFrames();
+            }
+        }
+
+        const node = button.closest('[data-pid]');
+        if (node) {
+            // remember the state of the toggles of the process, for
+            // when it is rendered again
+            const pid = Number(node.dataset.pid);
+            const open = new Set();
+            node.querySelectorAll('.toggle').forEach((b, i) => {
+                if (b.parentNode.classList.contains('toggled')) {
+                    open.add(i);
+                }
+            });
+            aperti.set(pid, open);
+            if (detailsOpen(node)) {
+                conDettagli.add(pid);
+                const d = dettagli.get(pid);
+                if (!d || d.vecchi) {
+                    requestDetails(pid);
+                }
+            } else {
+                conDettagli.delete(pid);
+            }
+        }
+        renderAll();
+    });
+
+    window.addEventListener('scroll', renderAll);
+    window.addEventListener('resize', () => {
+        renderAll();
+        drawFrames();
+    });
+
+    window.addEventListener('message', (event) => {
+        const msg = event.data;
+        switch (msg.command) {
+            case 'processi':
+                updateProcesses(msg);
+                break;
+            case 'dettagli':
+                updateDetails(msg);
+                break;
+            case 'sezione':
+                updateSection(msg);
+                break;
+        }
+    });
+
+    // the frame under the mouse
+    function frameTitle(event) {
+        const canvas = event.target;
+        const step = FRAME_SIZE + FRAME_GAP;
+        const cols = Math.floor(canvas.width / step);
+        const i = Math.floor(event.offsetY / step) * cols + Math.floor(event.offsetX / step);
+        if (!frameData || i >= frameData.frame.length) {
+            canvas.title = '';
+            return;
+        }
+        const v = frameData.frame[i];
+        canvas.title = `frame ${frameData.n_m1 + i}: ` + (v < 0 ? 'libero' : v == 0 ? 'pagina' : `tabella, ${v} entrate valide`);
+    }
+
+    document.addEventListener('DOMContentLoaded', (event) => {
+        addIcons(document);
+        document.getElementById('frame').addEventListener('mousemove', frameTitle);
+        const current = () => storiaPos < 0 ? storia.entries.length - 1 : storiaPos;
+        document.getElementById('storia-pos').addEventListener('input', (event) => moveStoria(Number(event.target.value)));
+        document.getElementById('storia-prec').addEventListener('click', () => moveStoria(current() - 1));
+        document.getElementById('storia-succ').addEventListener('click', () => moveStoria(current() + 1));
+        lists.sistema = new VirtualList(document.getElementById('sistema'));
+        lists.utente = new VirtualList(document.getElementById('utente'));
+        vscode.postMessage({ command: 'ready' });
     });
-    
-    
 }());
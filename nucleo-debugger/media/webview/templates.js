@@ -0,0 +1,303 @@
+(function() {
+  var template = Handlebars.template, templates = Handlebars.templates = Handlebars.templates || {};
+templates['dump'] = template({"1":function(container,depth0,helpers,partials,data) {
+    var helper, alias1=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "	<li class=\"p-dmp-item\"> <span class=\"key\">"
+    + alias1(((helper = (helper = lookupProperty(helpers,"key") || (data && lookupProperty(data,"key"))) != null ? helper : container.hooks.helperMissing),(typeof helper === "function" ? helper.call(depth0 != null ? depth0 : (container.nullContext || {}),{"name":"key","hash":{},"data":data,"loc":{"start":{"line":2,"column":43},"end":{"line":2,"column":51}}}) : helper)))
+    + " =</span> <span class=\"value\">"
+    + alias1(container.lambda(depth0, depth0))
+    + "</span></li>\n";
+},"3":function(container,depth0,helpers,partials,data) {
+    return "	<li class=\"p-dmp-item\"> <span class=\"info\">...</span></li>\n";
+},"compiler":[8,">= 4.3.0"],"main":function(container,depth0,helpers,partials,data) {
+    var stack1, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return ((stack1 = lookupProperty(helpers,"each").call(depth0 != null ? depth0 : (container.nullContext || {}),depth0,{"name":"each","hash":{},"fn":container.program(1, data, 0),"inverse":container.program(3, data, 0),"data":data,"loc":{"start":{"line":1,"column":0},"end":{"line":5,"column":9}}})) != null ? stack1 : "");
+},"useData":true});
+templates['process'] = template({"1":function(container,depth0,helpers,partials,data) {
+    var helper, alias1=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "					<li class=\"p-dmp-item\"> <span class=\"key\">"
+    + alias1(((helper = (helper = lookupProperty(helpers,"key") || (data && lookupProperty(data,"key"))) != null ? helper : container.hooks.helperMissing),(typeof helper === "function" ? helper.call(depth0 != null ? depth0 : (container.nullContext || {}),{"name":"key","hash":{},"data":data,"loc":{"start":{"line":12,"column":47},"end":{"line":12,"column":55}}}) : helper)))
+    + " =</span> <span class=\"value\">"
+    + alias1(container.lambda(depth0, depth0))
+    + "</span></li>\n";
+},"compiler":[8,">= 4.3.0"],"main":function(container,depth0,helpers,partials,data) {
+    var stack1, helper, alias1=depth0 != null ? depth0 : (container.nullContext || {}), alias2=container.hooks.helperMissing, alias3="function", alias4=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "<div class=\"\" data-pid=\""
+    + alias4(((helper = (helper = lookupProperty(helpers,"pid") || (depth0 != null ? lookupProperty(depth0,"pid") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"pid","hash":{},"data":data,"loc":{"start":{"line":1,"column":24},"end":{"line":1,"column":31}}}) : helper)))
+    + "\">\n	<h3 class=\"p-title toggle\"><span class=\"key\">["
+    + alias4(((helper = (helper = lookupProperty(helpers,"pid") || (depth0 != null ? lookupProperty(depth0,"pid") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"pid","hash":{},"data":data,"loc":{"start":{"line":2,"column":47},"end":{"line":2,"column":54}}}) : helper)))
+    + "]</span><span class=\"info\">: object</span></h3>\n	<ul class=\"p-dump toggable\">\n		<li class=\"p-item\"><span class=\"key\"> pid = </span> <span class=\"value\">"
+    + alias4(((helper = (helper = lookupProperty(helpers,"pid") || (depth0 != null ? lookupProperty(depth0,"pid") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"pid","hash":{},"data":data,"loc":{"start":{"line":4,"column":74},"end":{"line":4,"column":81}}}) : helper)))
+    + "</span></li>\n		<li class=\"p-item\"><span class=\"key\"> livello = </span> <span class=\"value\">"
+    + alias4(((helper = (helper = lookupProperty(helpers,"livello") || (depth0 != null ? lookupProperty(depth0,"livello") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"livello","hash":{},"data":data,"loc":{"start":{"line":5,"column":78},"end":{"line":5,"column":89}}}) : helper)))
+    + "</span></li>\n		<li class=\"p-item\"><span class=\"key\"> corpo = </span> <span class=\"value\">"
+    + alias4(((helper = (helper = lookupProperty(helpers,"corpo") || (depth0 != null ? lookupProperty(depth0,"corpo") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"corpo","hash":{},"data":data,"loc":{"start":{"line":6,"column":76},"end":{"line":6,"column":85}}}) : helper)))
+    + "</span></li>\n		<li class=\"p-item\"><span class=\"key\"> rip = </span> <span class=\"value\">"
+    + alias4(((helper = (helper = lookupProperty(helpers,"rip") || (depth0 != null ? lookupProperty(depth0,"rip") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"rip","hash":{},"data":data,"loc":{"start":{"line":7,"column":74},"end":{"line":7,"column":81}}}) : helper)))
+    + "</span></li>\n		<li class=\"p-ca-dump-list\" >\n			<div class=\"toggle\"><span class=\"key\">campi aggiuntivi</span><span class=\"info\">: array[]</span></div>\n			<ul class=\"toggable\">\n"
+    + ((stack1 = lookupProperty(helpers,"each").call(alias1,(depth0 != null ? lookupProperty(depth0,"campi_aggiuntivi") : depth0),{"name":"each","hash":{},"fn":container.program(1, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":11,"column":4},"end":{"line":13,"column":13}}})) != null ? stack1 : "")
+    + "			</ul>\n		</li>\n		<li class=\"p-dump-list\">\n			<div class=\"toggle\"><span class=\"key\">dump pila</span><span class=\"info\">: array[]</span></div>\n			<ul class=\"toggable\" data-dump=\"pila_dmp\"></ul>\n		</li>\n		<li class=\"p-dump-list\">\n			<div class=\"toggle\"><span class=\"key\">dump registri</span><span class=\"info\">: array[]</span></div>\n			<ul class=\"toggable\" data-dump=\"reg_dmp\"></ul>\n		</li>\n		<li class=\"p-dump-list\">\n			<div class=\"toggle\"><span class=\"key\">mappa memoria</span><span class=\"info\">: array[]</span></div>\n			<ul class=\"toggable\" data-dump=\"regioni\" data-template=\"regioni\"></ul>\n		</li>\n	</ul>\n</div>\n";
+},"useData":true});
+templates['regioni'] = template({"1":function(container,depth0,helpers,partials,data) {
+    var helper, alias1=depth0 != null ? depth0 : (container.nullContext || {}), alias2=container.hooks.helperMissing, alias3="function", alias4=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "	<li class=\"p-dmp-item\">\n		<span class=\"value\">"
+    + alias4(((helper = (helper = lookupProperty(helpers,"inizio") || (depth0 != null ? lookupProperty(depth0,"inizio") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"inizio","hash":{},"data":data,"loc":{"start":{"line":3,"column":22},"end":{"line":3,"column":32}}}) : helper)))
+    + "-"
+    + alias4(((helper = (helper = lookupProperty(helpers,"fine") || (depth0 != null ? lookupProperty(depth0,"fine") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"fine","hash":{},"data":data,"loc":{"start":{"line":3,"column":33},"end":{"line":3,"column":41}}}) : helper)))
+    + "</span> <span class=\"key\">"
+    + alias4(((helper = (helper = lookupProperty(helpers,"accesso") || (depth0 != null ? lookupProperty(depth0,"accesso") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"accesso","hash":{},"data":data,"loc":{"start":{"line":3,"column":67},"end":{"line":3,"column":78}}}) : helper)))
+    + "</span> "
+    + alias4(((helper = (helper = lookupProperty(helpers,"parte") || (depth0 != null ? lookupProperty(depth0,"parte") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"parte","hash":{},"data":data,"loc":{"start":{"line":3,"column":86},"end":{"line":3,"column":95}}}) : helper)))
+    + " <span class=\"info\">"
+    + alias4(((helper = (helper = lookupProperty(helpers,"traduzioni") || (depth0 != null ? lookupProperty(depth0,"traduzioni") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"traduzioni","hash":{},"data":data,"loc":{"start":{"line":3,"column":115},"end":{"line":3,"column":129}}}) : helper)))
+    + "</span>\n	</li>\n";
+},"3":function(container,depth0,helpers,partials,data) {
+    return "	<li class=\"p-dmp-item\"> <span class=\"info\">...</span></li>\n";
+},"compiler":[8,">= 4.3.0"],"main":function(container,depth0,helpers,partials,data) {
+    var stack1, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return ((stack1 = lookupProperty(helpers,"each").call(depth0 != null ? depth0 : (container.nullContext || {}),depth0,{"name":"each","hash":{},"fn":container.program(1, data, 0),"inverse":container.program(3, data, 0),"data":data,"loc":{"start":{"line":1,"column":0},"end":{"line":7,"column":9}}})) != null ? stack1 : "");
+},"useData":true});
+templates['semafori'] = template({"1":function(container,depth0,helpers,partials,data) {
+    var stack1, helper, alias1=depth0 != null ? depth0 : (container.nullContext || {}), alias2=container.hooks.helperMissing, alias3="function", alias4=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "	<div class=\"p-dmp-item\">\n		<span class=\"key\">sem["
+    + alias4(((helper = (helper = lookupProperty(helpers,"id") || (depth0 != null ? lookupProperty(depth0,"id") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"id","hash":{},"data":data,"loc":{"start":{"line":3,"column":24},"end":{"line":3,"column":30}}}) : helper)))
+    + "]</span><span class=\"info\">: "
+    + alias4(((helper = (helper = lookupProperty(helpers,"counter") || (depth0 != null ? lookupProperty(depth0,"counter") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"counter","hash":{},"data":data,"loc":{"start":{"line":3,"column":59},"end":{"line":3,"column":70}}}) : helper)))
+    + "</span>\n"
+    + ((stack1 = lookupProperty(helpers,"each").call(alias1,(depth0 != null ? lookupProperty(depth0,"pointer") : depth0),{"name":"each","hash":{},"fn":container.program(2, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":4,"column":2},"end":{"line":6,"column":11}}})) != null ? stack1 : "")
+    + ((stack1 = lookupProperty(helpers,"if").call(alias1,((stack1 = (depth0 != null ? lookupProperty(depth0,"attese") : depth0)) != null ? lookupProperty(stack1,"length") : stack1),{"name":"if","hash":{},"fn":container.program(4, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":7,"column":2},"end":{"line":12,"column":9}}})) != null ? stack1 : "")
+    + "	</div>\n";
+},"2":function(container,depth0,helpers,partials,data) {
+    var helper, alias1=depth0 != null ? depth0 : (container.nullContext || {}), alias2=container.hooks.helperMissing, alias3="function", alias4=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "			<span class=\"s-arrow\">&#x279e;</span> <span class=\"value\">["
+    + alias4(((helper = (helper = lookupProperty(helpers,"pid") || (depth0 != null ? lookupProperty(depth0,"pid") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"pid","hash":{},"data":data,"loc":{"start":{"line":5,"column":62},"end":{"line":5,"column":69}}}) : helper)))
+    + ", "
+    + alias4(((helper = (helper = lookupProperty(helpers,"precedenza") || (depth0 != null ? lookupProperty(depth0,"precedenza") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"precedenza","hash":{},"data":data,"loc":{"start":{"line":5,"column":71},"end":{"line":5,"column":85}}}) : helper)))
+    + "]</span>\n";
+},"4":function(container,depth0,helpers,partials,data) {
+    var stack1, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "			<span class=\"key\">any:</span>\n"
+    + ((stack1 = lookupProperty(helpers,"each").call(depth0 != null ? depth0 : (container.nullContext || {}),(depth0 != null ? lookupProperty(depth0,"attese") : depth0),{"name":"each","hash":{},"fn":container.program(5, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":9,"column":3},"end":{"line":11,"column":12}}})) != null ? stack1 : "");
+},"5":function(container,depth0,helpers,partials,data) {
+    var helper, alias1=depth0 != null ? depth0 : (container.nullContext || {}), alias2=container.hooks.helperMissing, alias3="function", alias4=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "				<span class=\"s-arrow\">&#x279e;</span> <span class=\"value\">["
+    + alias4(((helper = (helper = lookupProperty(helpers,"pid") || (depth0 != null ? lookupProperty(depth0,"pid") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"pid","hash":{},"data":data,"loc":{"start":{"line":10,"column":63},"end":{"line":10,"column":70}}}) : helper)))
+    + ", "
+    + alias4(((helper = (helper = lookupProperty(helpers,"precedenza") || (depth0 != null ? lookupProperty(depth0,"precedenza") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"precedenza","hash":{},"data":data,"loc":{"start":{"line":10,"column":72},"end":{"line":10,"column":86}}}) : helper)))
+    + "]</span>\n";
+},"7":function(container,depth0,helpers,partials,data) {
+    return "	<div class=\"p-dmp-item\"><span class=\"info\">nessun processo bloccato</span></div>\n";
+},"compiler":[8,">= 4.3.0"],"main":function(container,depth0,helpers,partials,data) {
+    var stack1, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return ((stack1 = lookupProperty(helpers,"each").call(depth0 != null ? depth0 : (container.nullContext || {}),(depth0 != null ? lookupProperty(depth0,"sem") : depth0),{"name":"each","hash":{},"fn":container.program(1, data, 0),"inverse":container.program(7, data, 0),"data":data,"loc":{"start":{"line":1,"column":0},"end":{"line":16,"column":9}}})) != null ? stack1 : "");
+},"useData":true});
+templates['sospesi'] = template({"1":function(container,depth0,helpers,partials,data) {
+    var helper, alias1=depth0 != null ? depth0 : (container.nullContext || {}), alias2=container.hooks.helperMissing, alias3="function", alias4=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "	<div class=\"p-dmp-item\">\n		<span class=\"key\">["
+    + alias4(((helper = (helper = lookupProperty(helpers,"pid") || (depth0 != null ? lookupProperty(depth0,"pid") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"pid","hash":{},"data":data,"loc":{"start":{"line":4,"column":21},"end":{"line":4,"column":28}}}) : helper)))
+    + ", "
+    + alias4(((helper = (helper = lookupProperty(helpers,"precedenza") || (depth0 != null ? lookupProperty(depth0,"precedenza") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"precedenza","hash":{},"data":data,"loc":{"start":{"line":4,"column":30},"end":{"line":4,"column":44}}}) : helper)))
+    + "]</span>\n		<span class=\"value\">+"
+    + alias4(((helper = (helper = lookupProperty(helpers,"d_attesa") || (depth0 != null ? lookupProperty(depth0,"d_attesa") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"d_attesa","hash":{},"data":data,"loc":{"start":{"line":5,"column":23},"end":{"line":5,"column":35}}}) : helper)))
+    + "</span> <span class=\"s-arrow\">&#x279e;</span> <span class=\"key\">tick</span> <span class=\"value\">"
+    + alias4(((helper = (helper = lookupProperty(helpers,"sveglia") || (depth0 != null ? lookupProperty(depth0,"sveglia") : depth0)) != null ? helper : alias2),(typeof helper === alias3 ? helper.call(alias1,{"name":"sveglia","hash":{},"data":data,"loc":{"start":{"line":5,"column":131},"end":{"line":5,"column":142}}}) : helper)))
+    + "</span>\n	</div>\n";
+},"3":function(container,depth0,helpers,partials,data) {
+    return "	<div class=\"p-dmp-item\"><span class=\"info\">nessun processo sospeso</span></div>\n";
+},"compiler":[8,">= 4.3.0"],"main":function(container,depth0,helpers,partials,data) {
+    var stack1, helper, alias1=depth0 != null ? depth0 : (container.nullContext || {}), lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "<div class=\"p-dmp-item\"><span class=\"key\">tick attuale =</span> <span class=\"value\">"
+    + container.escapeExpression(((helper = (helper = lookupProperty(helpers,"tick") || (depth0 != null ? lookupProperty(depth0,"tick") : depth0)) != null ? helper : container.hooks.helperMissing),(typeof helper === "function" ? helper.call(alias1,{"name":"tick","hash":{},"data":data,"loc":{"start":{"line":1,"column":84},"end":{"line":1,"column":92}}}) : helper)))
+    + "</span></div>\n"
+    + ((stack1 = lookupProperty(helpers,"each").call(alias1,(depth0 != null ? lookupProperty(depth0,"sospesi") : depth0),{"name":"each","hash":{},"fn":container.program(1, data, 0),"inverse":container.program(3, data, 0),"data":data,"loc":{"start":{"line":2,"column":0},"end":{"line":9,"column":9}}})) != null ? stack1 : "");
+},"useData":true});
+templates['storia'] = template({"1":function(container,depth0,helpers,partials,data) {
+    var stack1, alias1=container.lambda, alias2=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "	<div class=\"p-dmp-item\">\n		<span class=\"key\">modifica</span> <span class=\"value\">"
+    + alias2(alias1(((stack1 = (depth0 != null ? lookupProperty(depth0,"entry") : depth0)) != null ? lookupProperty(stack1,"i") : stack1), depth0))
+    + "</span>\n		<span class=\"key\">tick</span> <span class=\"value\">"
+    + alias2(alias1(((stack1 = (depth0 != null ? lookupProperty(depth0,"entry") : depth0)) != null ? lookupProperty(stack1,"tick") : stack1), depth0))
+    + "</span>\n		<span class=\"info\">"
+    + alias2(alias1(((stack1 = (depth0 != null ? lookupProperty(depth0,"entry") : depth0)) != null ? lookupProperty(stack1,"motivo") : stack1), depth0))
+    + "</span> "
+    + alias2(alias1(((stack1 = (depth0 != null ? lookupProperty(depth0,"entry") : depth0)) != null ? lookupProperty(stack1,"dove") : stack1), depth0))
+    + "\n	</div>\n";
+},"3":function(container,depth0,helpers,partials,data) {
+    var stack1, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "	<div class=\"p-dmp-item\"><span class=\"key\">esecuzione"
+    + ((stack1 = lookupProperty(helpers,"if").call(depth0 != null ? depth0 : (container.nullContext || {}),((stack1 = (data && lookupProperty(data,"root"))) && lookupProperty(stack1,"smp")),{"name":"if","hash":{},"fn":container.program(4, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":9,"column":53},"end":{"line":9,"column":89}}})) != null ? stack1 : "")
+    + " =</span> <span class=\"value\">["
+    + container.escapeExpression(container.lambda(depth0, depth0))
+    + "]</span></div>\n";
+},"4":function(container,depth0,helpers,partials,data) {
+    var helper, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "["
+    + container.escapeExpression(((helper = (helper = lookupProperty(helpers,"index") || (data && lookupProperty(data,"index"))) != null ? helper : container.hooks.helperMissing),(typeof helper === "function" ? helper.call(depth0 != null ? depth0 : (container.nullContext || {}),{"name":"index","hash":{},"data":data,"loc":{"start":{"line":9,"column":71},"end":{"line":9,"column":81}}}) : helper)))
+    + "]";
+},"6":function(container,depth0,helpers,partials,data) {
+    var stack1, alias1=depth0 != null ? depth0 : (container.nullContext || {}), lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "	<div class=\"p-dmp-item\"><span class=\"key\">pronti"
+    + ((stack1 = lookupProperty(helpers,"if").call(alias1,((stack1 = (data && lookupProperty(data,"root"))) && lookupProperty(stack1,"smp")),{"name":"if","hash":{},"fn":container.program(4, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":12,"column":49},"end":{"line":12,"column":85}}})) != null ? stack1 : "")
+    + " =</span>\n		"
+    + ((stack1 = lookupProperty(helpers,"each").call(alias1,depth0,{"name":"each","hash":{},"fn":container.program(7, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":13,"column":2},"end":{"line":13,"column":128}}})) != null ? stack1 : "")
+    + "\n	</div>\n";
+},"7":function(container,depth0,helpers,partials,data) {
+    var stack1, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "<span class=\"value\">["
+    + container.escapeExpression(container.lambda(depth0, depth0))
+    + "]</span> "
+    + ((stack1 = lookupProperty(helpers,"unless").call(depth0 != null ? depth0 : (container.nullContext || {}),(data && lookupProperty(data,"last")),{"name":"unless","hash":{},"fn":container.program(8, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":13,"column":54},"end":{"line":13,"column":119}}})) != null ? stack1 : "");
+},"8":function(container,depth0,helpers,partials,data) {
+    return "<span class=\"s-arrow\">&#x279e;</span>";
+},"10":function(container,depth0,helpers,partials,data) {
+    var stack1, helper, alias1=depth0 != null ? depth0 : (container.nullContext || {}), lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "	<div class=\"p-dmp-item\"><span class=\"key\">sem["
+    + container.escapeExpression(((helper = (helper = lookupProperty(helpers,"key") || (data && lookupProperty(data,"key"))) != null ? helper : container.hooks.helperMissing),(typeof helper === "function" ? helper.call(alias1,{"name":"key","hash":{},"data":data,"loc":{"start":{"line":17,"column":47},"end":{"line":17,"column":55}}}) : helper)))
+    + "] =</span>\n		"
+    + ((stack1 = lookupProperty(helpers,"each").call(alias1,depth0,{"name":"each","hash":{},"fn":container.program(7, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":18,"column":2},"end":{"line":18,"column":128}}})) != null ? stack1 : "")
+    + "\n	</div>\n";
+},"12":function(container,depth0,helpers,partials,data) {
+    var stack1, alias1=container.lambda, alias2=container.escapeExpression, lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return "<span class=\"value\">["
+    + alias2(alias1((depth0 != null ? lookupProperty(depth0,"0") : depth0), depth0))
+    + "]</span> <span class=\"info\">+"
+    + alias2(alias1((depth0 != null ? lookupProperty(depth0,"1") : depth0), depth0))
+    + "</span> "
+    + ((stack1 = lookupProperty(helpers,"unless").call(depth0 != null ? depth0 : (container.nullContext || {}),(data && lookupProperty(data,"last")),{"name":"unless","hash":{},"fn":container.program(8, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":22,"column":106},"end":{"line":22,"column":171}}})) != null ? stack1 : "");
+},"compiler":[8,">= 4.3.0"],"main":function(container,depth0,helpers,partials,data) {
+    var stack1, alias1=depth0 != null ? depth0 : (container.nullContext || {}), lookupProperty = container.lookupProperty || function(parent, propertyName) {
+        if (Object.prototype.hasOwnProperty.call(parent, propertyName)) {
+          return parent[propertyName];
+        }
+        return undefined
+    };
+
+  return ((stack1 = lookupProperty(helpers,"if").call(alias1,(depth0 != null ? lookupProperty(depth0,"entry") : depth0),{"name":"if","hash":{},"fn":container.program(1, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":1,"column":0},"end":{"line":7,"column":7}}})) != null ? stack1 : "")
+    + ((stack1 = lookupProperty(helpers,"each").call(alias1,((stack1 = (depth0 != null ? lookupProperty(depth0,"stato") : depth0)) != null ? lookupProperty(stack1,"esecuzione") : stack1),{"name":"each","hash":{},"fn":container.program(3, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":8,"column":0},"end":{"line":10,"column":9}}})) != null ? stack1 : "")
+    + ((stack1 = lookupProperty(helpers,"each").call(alias1,((stack1 = (depth0 != null ? lookupProperty(depth0,"stato") : depth0)) != null ? lookupProperty(stack1,"pronti") : stack1),{"name":"each","hash":{},"fn":container.program(6, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":11,"column":0},"end":{"line":15,"column":9}}})) != null ? stack1 : "")
+    + ((stack1 = lookupProperty(helpers,"each").call(alias1,((stack1 = (depth0 != null ? lookupProperty(depth0,"stato") : depth0)) != null ? lookupProperty(stack1,"sem") : stack1),{"name":"each","hash":{},"fn":container.program(10, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":16,"column":0},"end":{"line":20,"column":9}}})) != null ? stack1 : "")
+    + "<div class=\"p-dmp-item\"><span class=\"key\">sospesi =</span>\n	"
+    + ((stack1 = lookupProperty(helpers,"each").call(alias1,((stack1 = (depth0 != null ? lookupProperty(depth0,"stato") : depth0)) != null ? lookupProperty(stack1,"sospesi") : stack1),{"name":"each","hash":{},"fn":container.program(12, data, 0),"inverse":container.noop,"data":data,"loc":{"start":{"line":22,"column":1},"end":{"line":22,"column":180}}})) != null ? stack1 : "")
+    + "\n</div>\n";
+},"useData":true});
+})();
\ No newline at end of file
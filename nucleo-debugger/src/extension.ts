@@ -8,12 +8,70 @@ import { NucleoInfo } from './nucleoweb';
 export function activate(context: vscode.ExtensionContext) {
 	vscode.debug.onDidStartDebugSession( ()=>{
         NucleoInfo.createInfoPanel(context.extensionUri);
-    }); 
+    });
 
     vscode.debug.onDidTerminateDebugSession(() =>{
         NucleoInfo.currentPanel?.dispose();
     });
- 
+
+	// Refresh the panel only when the target stops: while it is running
+	// the kernel state cannot be read
+	context.subscriptions.push(vscode.debug.registerDebugAdapterTrackerFactory('cppdbg', {
+		createDebugAdapterTracker(session: vscode.DebugSession) {
+			return {
+				onDidSendMessage: message => {
+					if (message.type != 'event') {
+						return;
+					}
+					if (message.event == 'stopped') {
+						NucleoInfo.currentPanel?.requestRefresh();
+					} else if (message.event == 'continued') {
+						NucleoInfo.currentPanel?.cancelRefresh();
+					}
+				}
+			};
+		}
+	}));
+
+	// ... and when the user selects another stack frame
+	context.subscriptions.push(vscode.debug.onDidChangeActiveStackItem(item => {
+		if (item instanceof vscode.DebugStackFrame) {
+			NucleoInfo.currentPanel?.requestRefresh();
+		}
+	}));
+
+	// CESNAP asks the run script to restart from a QEMU snapshot taken
+	// after the initialization. The variable reaches the 'boot -g' task
+	// through the environment of the terminals
+	const applySnapshot = () => {
+		if (vscode.workspace.getConfiguration('nucleo-debugger').get<boolean>('istantanea')) {
+			context.environmentVariableCollection.replace('CESNAP', '1');
+		} else {
+			context.environmentVariableCollection.delete('CESNAP');
+		}
+	};
+	applySnapshot();
+	context.subscriptions.push(vscode.workspace.onDidChangeConfiguration(e => {
+		if (e.affectsConfiguration('nucleo-debugger.istantanea')) {
+			applySnapshot();
+		}
+	}));
+
+	// the snapshot is discarded by the run script when the modules change,
+	// but not when only the hard disk or libce do
+	context.subscriptions.push(vscode.commands.registerCommand('nucleo-debugger.scartaIstantanea', async () => {
+		for (const folder of vscode.workspace.workspaceFolders ?? []) {
+			for (const name of ['snap.qcow2', 'snap.qcow2.id']) {
+				try {
+					await vscode.workspace.fs.delete(vscode.Uri.joinPath(folder.uri, 'build', name));
+				} catch {
+					// not there
+				}
+			}
+		}
+		vscode.window.showInformationMessage('Istantanea scartata: la prossima sessione ripartirà da capo');
+	}));
+
 }
 
 // This method is called when your extension is deactivated
@@ -1,7 +1,4 @@
 import * as vscode from 'vscode';
-const Handlebars = require('handlebars');
-
-let interval: NodeJS.Timeout;
 
 export class NucleoInfo {
     public static currentPanel: NucleoInfo | undefined;
@@ -9,8 +6,37 @@ export class NucleoInfo {
 	public static readonly viewType = 'nucleoInfo';
 
 	private readonly _extensionUri: vscode.Uri;
-	
-	public process_list: any | undefined;
+
+	// processes shown in the panel, by pid
+	public process_list: Map<number, any> = new Map();
+	// sequence number of the last process list received from gdb
+	// (undefined: ask for the whole list)
+	private _seq: number | undefined;
+	// incremented every time the webview is (re)loaded, to discard the
+	// answers to requests sent before
+	private _webviewGen = 0;
+
+	// refresh scheduling: the requests are collected for refreshDelay ms,
+	// and only one refresh at a time is sent to gdb
+	private static readonly refreshDelay = 100;
+	private _timer: NodeJS.Timeout | undefined;
+	private _inFlight = false;
+	private _pending = false;
+	// the gdb commands are sent one at a time, in order
+	private _lastCommand: Promise<any> = Promise.resolve();
+
+	// the other sections of the panel, with the gdb command that fills
+	// them. A section is refreshed only while it is open in the webview
+	private static readonly sezioni: { [nome: string]: (panel: NucleoInfo) => string } = {
+		semafori: () => "semaphore -json waiting",
+		sospesi: () => "queue -json sospesi",
+		frame: () => "frames -json",
+		// the webview keeps the history: ask only for the new changes
+		storia: (panel) => `timeline -json -since ${panel._storiaNext}`,
+	};
+	private _sezioniAperte: Set<string> = new Set();
+	// index of the first change of the scheduler history not yet sent
+	private _storiaNext = 0;
 	// delare your new GDB response variable
 	// public VAR: any | undefined;
 
@@ -19,68 +45,157 @@ export class NucleoInfo {
     private constructor(panel: vscode.WebviewPanel, extensionUri: vscode.Uri) {
 		this._panel = panel;
 		this._extensionUri = extensionUri;
-		// Set the webview's initial html content
+		// Set the webview's initial html content: the processes are
+		// then added and updated by media/webview/main.js
 		this._update();
 
 		// Listen for when the panel is disposed
 		// This happens when the user closes the panel or when the panel is closed programmatically
 		this._panel.onDidDispose(() => this.dispose(), null, this._disposables);
 
-		// Update the content based on view changes (moved around the window)
-		// this._panel.onDidChangeViewState(
-		// 	e => {
-		// 		if (this._panel.visible) {
-		// 			this._update();
-		// 		}
-		// 	},
-		// 	null,
-		// 	this._disposables
-		// );
-
-        // This can be useful if you need to handle input from the webview
 		// Handle messages from the webview
-		// this._panel.webview.onDidReceiveMessage(
-		// 	message => {
-		// 		switch (message.command) {
-		// 			case 'alert':
-		// 				vscode.window.showErrorMessage(message.text);
-		// 				return;
-		// 		}
-		// 	},
-		// 	null,
-		// 	this._disposables
-		// );
-
-
-        const session = vscode.debug.activeDebugSession;
-		const updateInfo = async () => {
-			this.process_list = await this.customCommand(session, "process list");
-			
-			// Insert your command
-			// this.VAR = this.customCommand(session, "COMMAND");
-
-			const infoPanel = this._panel.webview;
-			
-
-			infoPanel.html = this._getHtmlForWebview();
-		};
-
-        interval = setInterval(updateInfo, 500);
+		this._panel.webview.onDidReceiveMessage(
+			message => {
+				switch (message.command) {
+					case 'ready':
+						// the webview has been (re)loaded and is empty
+						this._seq = undefined;
+						this._webviewGen++;
+						this.process_list.clear();
+						this._sezioniAperte.clear();
+						this._storiaNext = 0;
+						this.requestRefresh();
+						return;
+					case 'sezione':
+						// the user has opened or closed a section
+						if (!(message.nome in NucleoInfo.sezioni)) {
+							return;
+						}
+						if (message.aperta) {
+							this._sezioniAperte.add(message.nome);
+							this.sendSection(message.nome);
+						} else {
+							this._sezioniAperte.delete(message.nome);
+						}
+						return;
+					case 'dettagli':
+						// the user has opened the stack or registers of a process
+						this.sendDetails(message.pid);
+						return;
+				}
+			},
+			null,
+			this._disposables
+		);
 	}
 
     public dispose() {
 		// Clean up our resources
 		NucleoInfo.currentPanel = undefined;
-        clearInterval(interval);
+		this.cancelRefresh();
 		this._panel.dispose();
+		while (this._disposables.length) {
+			this._disposables.pop()?.dispose();
+		}
 	}
 
     // Update the webview
     private _update() {
-		// const infoPanel = this._panel.webview;
-        // infoPanel.html = this._getHtmlForWebview();
+		const infoPanel = this._panel.webview;
+        infoPanel.html = this._getHtmlForWebview();
+	}
+
+	// Ask for a refresh of the panel. Called when the target stops or the
+	// selected stack frame changes: bursts of calls (e.g. while stepping)
+	// result in a single refresh, sent when the previous one has completed
+	public requestRefresh() {
+		if (this._timer) {
+			clearTimeout(this._timer);
+		}
+		this._timer = setTimeout(() => {
+			this._timer = undefined;
+			this.runRefresh();
+		}, NucleoInfo.refreshDelay);
+	}
+
+	// Forget the pending refreshes. Called when the target resumes
+	public cancelRefresh() {
+		if (this._timer) {
+			clearTimeout(this._timer);
+			this._timer = undefined;
+		}
+		this._pending = false;
+	}
+
+	private async runRefresh() {
+		if (this._inFlight) {
+			this._pending = true;
+			return;
+		}
+		this._inFlight = true;
+		try {
+			await this.refresh();
+		} finally {
+			this._inFlight = false;
+		}
+		if (this._pending) {
+			this._pending = false;
+			this.requestRefresh();
+		}
 	}
 
+	// Fetch what has changed since the last refresh and send it to the webview.
+	private async refresh() {
+		const session = vscode.debug.activeDebugSession;
+		// the stack and registers of each process are fetched only when needed
+		const command = this._seq === undefined ? "process list -json -brief" : `process list -json -brief -since ${this._seq}`;
+		const gen = this._webviewGen;
+		let msg: any;
+		try {
+			const out = await this.customCommand(session, command);
+			if (out === undefined) {
+				return;
+			}
+			msg = JSON.parse(out);
+		} catch (e) {
+			// target running or output not in JSON: try again at the next stop
+			return;
+		}
+		if (gen != this._webviewGen) {
+			// the webview has been reloaded in the meantime
+			this._pending = true;
+			return;
+		}
+
+		// Insert your command
+		// this.VAR = this.customCommand(session, "COMMAND");
+
+		this._seq = msg.seq;
+		this._panel.webview.postMessage(this.applyProcessList(msg));
+
+		for (const nome of this._sezioniAperte) {
+			await this.sendSection(nome);
+		}
+	}
+
+	// Send the contents of a section to the webview
+	private async sendSection(nome: string) {
+		const session = vscode.debug.activeDebugSession;
+		let dati: any;
+		try {
+			const out = await this.customCommand(session, NucleoInfo.sezioni[nome](this));
+			if (out === undefined) {
+				return;
+			}
+			dati = JSON.parse(out);
+		} catch (e) {
+			return;
+		}
+		if (nome == 'storia') {
+			this._storiaNext = dati.next;
+		}
+		this._panel.webview.postMessage({ command: 'sezione', nome: nome, dati: dati });
+	}
 
     public static createInfoPanel(extensionUri: vscode.Uri) {
 		// Otherwise, create a new panel.
@@ -90,133 +205,150 @@ export class NucleoInfo {
 			vscode.ViewColumn.Beside,
 			getWebviewOptions(extensionUri),
 		);
-		NucleoInfo.currentPanel = new NucleoInfo(panel, extensionUri);		
+		NucleoInfo.currentPanel = new NucleoInfo(panel, extensionUri);
 	}
 
-    // execute custom command 
-    private async customCommand(session: typeof vscode.debug.activeDebugSession, command: string, arg?: any){
-		if(session) {
-			const sTrace = await session.customRequest('stackTrace', { threadId: 1 });
-			if(sTrace === undefined){
+	// Send the dump of the stack and of the registers of a process, and its
+	// memory map, to the webview
+	private async sendDetails(pid: number) {
+		const session = vscode.debug.activeDebugSession;
+		let msg: any, maps: any;
+		try {
+			const out = await this.customCommand(session, `process dump -json ${pid}`);
+			const outMaps = await this.customCommand(session, `vm maps -json ${pid}`);
+			if (out === undefined || outMaps === undefined) {
 				return;
 			}
-			const frameId = sTrace.stackFrames[0].id;
-		
+			msg = JSON.parse(out);
+			maps = JSON.parse(outMaps);
+		} catch (e) {
+			return;
+		}
+		this._panel.webview.postMessage({ command: 'dettagli', pid: pid, pila_dmp: msg.pila_dmp, reg_dmp: msg.reg_dmp, cr3: msg.cr3, regioni: maps.regioni });
+	}
+
+    // execute custom command, after the ones already sent
+    private customCommand(session: typeof vscode.debug.activeDebugSession, command: string, arg?: any){
+		const run = this._lastCommand.then(() => this.execCommand(session, command));
+		this._lastCommand = run.catch(() => undefined);
+		return run;
+	}
+
+    private async execCommand(session: typeof vscode.debug.activeDebugSession, command: string){
+		if(session) {
+			// use the frame selected by the user, if any, to avoid a stackTrace request
+			let frameId: number;
+			const item = vscode.debug.activeStackItem;
+			if (item instanceof vscode.DebugStackFrame && item.session.id == session.id) {
+				frameId = item.frameId;
+			} else {
+				const sTrace = await session.customRequest('stackTrace', { threadId: 1 });
+				if(sTrace === undefined){
+					return;
+				}
+				frameId = sTrace.stackFrames[0].id;
+			}
+
 			// Build and exec the command
 			const text = '-exec ' + command;
 			let result = session.customRequest('evaluate', {expression: text, frameId: frameId, context:'hover'}).then((response) => {
 				return response.result;
 			});
 			return result
-		}     
+		}
     }
 
-	// Handles the HTML formatting for the process_list command
-	private formatProcessList(){
-		let processListJson = JSON.parse(this.process_list);
-		let proc_count = processListJson.process.length;
-		let proc_sys: any = [];
-		let proc_utn: any = [];
-		processListJson.process.forEach(element => {
-			if(element.livello == "sistema"){
-				proc_sys.push(element);
-			}else{
-				proc_utn.push(element);
-			}
-		});
-		if(proc_count ==0){
-			return `<h3>PROCESSI IN ESECUZIONE<span class="info">: ${proc_count}</span></h3>`
+	// Apply the output of 'process list -json' (whole list or differences) to
+	// process_list, and build the message for the webview: the new or changed
+	// processes, and the pids of the removed ones. The webview renders them
+	// with the templates in media/webview/templates
+	private applyProcessList(msg: any) {
+		let update: any = { command: 'processi', reset: false, add: [], remove: [] };
+		if (msg.command == 'process_list') {
+			update.reset = true;
+			this.process_list.clear();
+			msg.process.forEach(element => {
+				this.process_list.set(element.pid, element);
+				update.add.push(element);
+			});
+		} else {
+			msg.added.forEach(element => {
+				this.process_list.set(element.pid, element);
+				update.add.push(element);
+			});
+			msg.changed.forEach(element => {
+				const p = Object.assign(this.process_list.get(element.pid) ?? {}, element);
+				this.process_list.set(element.pid, p);
+				update.add.push(p);
+			});
+			msg.removed.forEach(pid => {
+				this.process_list.delete(pid);
+				update.remove.push(pid);
+			});
 		}
-		let source = `
+		return update;
+	}
+
+	// The (initially empty) process list: main.js fills the 'sistema' and
+	// 'utente' sections, rendering only the processes that are visible
+	private formatProcessList(){
+		return `
 		<div class="">
-			<h3 class="toggle">PROCESSI IN ESECUZIONE<span class="info">: ${proc_count}</span></h3>
+			<h3 class="toggle">PROCESSI IN ESECUZIONE<span class="info" id="proc-count">: 0</span></h3>
 			<div class="toggable">
 				<div class="">
-					<h3 class="p-title toggle"><span class="key">sistema</span><span class="info">: ${proc_sys.length}</span></h3>
-					<div class="toggable">
-						{{#each proc_sys}}
-							<div class="">
-								<h3 class="p-title toggle"><span class="key">[{{pid}}]</span><span class="info">: object</span></h3>
-								<ul class="p-dump toggable">
-									<li class="p-item"><span class="key"> pid = </span> <span class="value">{{pid}}</span></li>			
-									<li class="p-item"><span class="key"> livello = </span> <span class="value">{{livello}}</span></li>			
-									<li class="p-item"><span class="key"> corpo = </span> <span class="value">{{corpo}}</span></li>			
-									<li class="p-item"><span class="key"> rip = </span> <span class="value">{{rip}}</span></li>
-									<li class="p-ca-dump-list" >
-										<div class="toggle"><span class="key">campi aggiuntivi</span><span class="info">: array[]</span></div> 
-										<ul class="toggable">
-											{{#each campi_aggiuntivi}}
-												<li class="p-dmp-item"> <span class="key">{{@key}} =</span> <span class="value">{{this}}</span></li>
-											{{/each}}
-										</ul>
-									</li>
-									<li class="p-dump-list "> 
-										<div class="toggle"><span class="key">dump Pila</span><span class="info">: array[]</span></div> 
-										<ul class="toggable">
-											{{#each pila_dmp}}
-												<li class="p-dmp-item"> <span class="key">{{@key}} =</span> <span class="value">{{this}}</span></li>
-											{{/each}}
-										</ul>
-									</li>
-									<li class="p-dump-list"> 
-										<div class="toggle"><span class="key">dump registri</span><span class="info">: array[]</span></div> 
-										<ul class="toggable">
-											{{#each reg_dmp}}
-												<li class="p-dmp-item"> <span class="key">{{@key}} =</span> <span class="value">{{this}}</span></li>
-											{{/each}}
-										</ul>
-									</li>
-								</ul>
-							</div>
-						{{/each}}
+					<h3 class="p-title toggle"><span class="key">sistema</span><span class="info" id="sistema-count">: 0</span></h3>
+					<div class="toggable vlist" id="sistema">
 					</div>
 				</div>
 				<div class="">
-					<h3 class="p-title toggle"><span class="key">utente</span><span class="info">: ${proc_utn.length}</span></h3>
-					<div class="toggable">
-						{{#each proc_utn}}
-							<div class="">
-								<h3 class="p-title toggle"><span class="key">[{{pid}}]</span><span class="info">: object</span></h3>
-								<ul class="p-dump toggable">
-									<li class="p-item"><span class="key"> pid = </span> <span class="value">{{pid}}</span></li>			
-									<li class="p-item"><span class="key"> livello = </span> <span class="value">{{livello}}</span></li>			
-									<li class="p-item"><span class="key"> corpo = </span> <span class="value">{{corpo}}</span></li>			
-									<li class="p-item"><span class="key"> rip = </span> <span class="value">{{rip}}</span></li>
-									<li class="p-ca-dump-list" >
-										<div class="toggle"><span class="key">campi aggiuntivi</span><span class="info">: array[]</span></div> 
-										<ul class="toggable">
-											{{#each campi_aggiuntivi}}
-												<li class="p-dmp-item"> <span class="key">{{@key}} =</span> <span class="value">{{this}}</span></li>
-											{{/each}}
-										</ul>
-									</li>
-									<li class="p-dump-list "> 
-										<div class="toggle"><span class="key">dump pila</span><span class="info">: array[]</span></div> 
-										<ul class="toggable">
-											{{#each pila_dmp}}
-												<li class="p-dmp-item"> <span class="key">{{@key}} =</span> <span class="value">{{this}}</span></li>
-											{{/each}}
-										</ul>
-									</li>
-									<li class="p-dump-list"> 
-										<div class="toggle"><span class="key">dump registri</span><span class="info">: array[]</span></div> 
-										<ul class="toggable">
-											{{#each reg_dmp}}
-												<li class="p-dmp-item"> <span class="key">{{@key}} =</span> <span class="value">{{this}}</span></li>
-											{{/each}}
-										</ul>
-									</li>
-								</ul>
-							</div>
-						{{/each}}
+					<h3 class="p-title toggle"><span class="key">utente</span><span class="info" id="utente-count">: 0</span></h3>
+					<div class="toggable vlist" id="utente">
 					</div>
 				</div>
 			</div>
 		</div>
 		`;
+	}
 
-		let template = Handlebars.compile(source);
-		return template({proc_sys: proc_sys, proc_utn: proc_utn,});
+	// The other sections, initially closed and empty: main.js asks for their
+	// contents when they are opened
+	private formatSections(){
+		return `
+		<div class="" data-sezione="semafori">
+			<h3 class="toggle">PROCESSI BLOCCATI SUI SEMAFORI</h3>
+			<div class="toggable" id="semafori">
+			</div>
+		</div>
+		<div class="" data-sezione="sospesi">
+			<h3 class="toggle">PROCESSI SOSPESI (TIMER)</h3>
+			<div class="toggable" id="sospesi">
+			</div>
+		</div>
+		<div class="" data-sezione="storia">
+			<h3 class="toggle">STORIA DELLO SCHEDULER<span class="info" id="storia-count"></span></h3>
+			<div class="toggable">
+				<div class="p-dmp-item">
+					<button class="t-button secondary" id="storia-prec">&#x25c0;</button>
+					<input type="range" id="storia-pos" min="0" max="0" value="0">
+					<button class="t-button secondary" id="storia-succ">&#x25b6;</button>
+				</div>
+				<div id="storia">
+				</div>
+			</div>
+		</div>
+		<div class="" data-sezione="frame">
+			<h3 class="toggle">FRAME DI M2<span class="info" id="frame-count"></span></h3>
+			<div class="toggable">
+				<canvas id="frame"></canvas>
+				<div class="p-dmp-item">
+					<span class="f-legend f-libero"></span><span class="key">libero</span>
+					<span class="f-legend f-pagina"></span><span class="key">pagina</span>
+					<span class="f-legend f-tabella"></span><span class="key">tabella (pi&ugrave; scuro: pi&ugrave; entrate valide)</span>
+				</div>
+			</div>
+		</div>
+		`;
 	}
 
     private _getHtmlForWebview() {
@@ -225,7 +357,7 @@ export class NucleoInfo {
 		// And the uri we use to load this script in the webview
 		const scriptUri = this._panel.webview.asWebviewUri(scriptPathOnDisk);
 
-		
+
 		// Local path to css styles
 		const styleResetPath = vscode.Uri.joinPath(this._extensionUri, '/media/webview', 'reset.css');
 		const stylesPathMainPath = vscode.Uri.joinPath(this._extensionUri, '/media/webview', 'vscode.css');
@@ -234,7 +366,11 @@ export class NucleoInfo {
 		const stylesResetUri = this._panel.webview.asWebviewUri(styleResetPath);
 		const stylesMainUri = this._panel.webview.asWebviewUri(stylesPathMainPath);
 		const codiconsUri = this._panel.webview.asWebviewUri(vscode.Uri.joinPath(this._extensionUri, 'node_modules', '@vscode/codicons', 'dist', 'codicon.css'));
-		let sourceDocument = `
+
+		// Handlebars runtime and the templates precompiled by 'yarn run templates'
+		const handlebarsUri = this._panel.webview.asWebviewUri(vscode.Uri.joinPath(this._extensionUri, 'node_modules', 'handlebars', 'dist', 'handlebars.runtime.min.js'));
+		const templatesUri = this._panel.webview.asWebviewUri(vscode.Uri.joinPath(this._extensionUri, '/media/webview', 'templates.js'));
+		return `
 		<!DOCTYPE html>
 			<html lang="en">
 				<head>
@@ -246,16 +382,15 @@ export class NucleoInfo {
 					<title>Info Nucleo</title>
 				</head>
 				<body>
-					{{{processList}}}
-					
+					${this.formatProcessList()}
+					${this.formatSections()}
+
+				<script src="${handlebarsUri}"></script>
+				<script src="${templatesUri}"></script>
 				<script src="${scriptUri}"></script>
 				</body>
 			</html>
 		`;
-
-		let template = Handlebars.compile(sourceDocument);
-		
-		return template({ processList: this.formatProcessList()});
 	}
 }
 